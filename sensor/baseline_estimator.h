@@ -0,0 +1,90 @@
+// Baseline (DC) estimators for the PPG signal
+//
+// Both estimators cost the same per sample regardless of window length and
+// share one interface: reset(), update(sample) -> baseline, value(), ready().
+
+#ifndef BASELINE_ESTIMATOR_H
+#define BASELINE_ESTIMATOR_H
+
+#include <stdint.h>
+
+// Moving average over the last N samples, kept as a running sum.
+// Until the window has filled, the average covers only the samples seen so
+// far, so the estimate is not dragged towards zero at startup.
+// The sum is a long: fine for 18-bit samples and windows up to 8192.
+template <uint16_t N>
+class MovingAverageBaseline {
+public:
+  MovingAverageBaseline() { reset(); }
+
+  void reset() {
+    sum = 0;
+    count = 0;
+    head = 0;
+    mean = 0;
+  }
+
+  long update(long sample) {
+    if (count == N) {
+      sum -= window[head];  // Drop the oldest sample
+    } else {
+      count++;
+    }
+    window[head] = sample;
+    sum += sample;
+    head = (head + 1 == N) ? 0 : head + 1;
+    mean = sum / (long)count;
+    return mean;
+  }
+
+  long value() const { return mean; }
+  bool ready() const { return count == N; }
+
+private:
+  long window[N];
+  long sum;
+  uint16_t count;
+  uint16_t head;
+  long mean;
+};
+
+// Single-pole IIR low-pass: y += (x - y) / 2^SHIFT, state kept with 8
+// fractional bits. During warm-up the gain starts at 1/1, 1/2, 1/4, ...
+// (a cumulative mean) until it reaches 1/2^SHIFT, which removes the long
+// settling tail a zero-initialised filter would have.
+template <uint8_t SHIFT>
+class IirBaseline {
+public:
+  IirBaseline() { reset(); }
+
+  void reset() {
+    state = 0;
+    warmupShift = 0;
+    count = 0;
+  }
+
+  long update(long sample) {
+    long scaled = sample << FRACTION_BITS;
+    if (count == 0) {
+      state = scaled;
+    } else {
+      state += (scaled - state) >> warmupShift;
+    }
+    // Double the time constant every time the sample count reaches a power of two
+    if (warmupShift < SHIFT && ++count >= (1UL << warmupShift)) {
+      warmupShift++;
+    }
+    return value();
+  }
+
+  long value() const { return state >> FRACTION_BITS; }
+  bool ready() const { return warmupShift == SHIFT; }
+
+private:
+  static const uint8_t FRACTION_BITS = 8;
+  long state;
+  uint8_t warmupShift;
+  unsigned long count;
+};
+
+#endif // BASELINE_ESTIMATOR_H
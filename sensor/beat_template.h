@@ -0,0 +1,95 @@
+// Learned pulse template for confirming beats
+//
+// The template is the average shape of the first confident beats of a
+// session: the SHAPE samples of band-passed AC up to each detected peak,
+// zero mean and scaled to +/-1024. A candidate peak is then scored by the
+// normalized cross-correlation of the newest SHAPE samples with it. With
+// the signal clipped to 16 bits the dot product fits in 32 bits, so a
+// match costs SHAPE integer multiply-adds and one float square root.
+
+#ifndef BEAT_TEMPLATE_H
+#define BEAT_TEMPLATE_H
+
+#include <math.h>
+#include <stdint.h>
+#include "history_ring.h"
+
+template <uint8_t SHAPE>
+class BeatTemplate {
+public:
+  explicit BeatTemplate(uint8_t beatsToLearn) : learnBeats(beatsToLearn) { reset(); }
+
+  void reset() {
+    recent.reset();
+    for (uint8_t i = 0; i < SHAPE; i++) sums[i] = 0;
+    learned = 0;
+    templateReady = false;
+  }
+
+  // One band-passed AC sample, before the peak detector sees it
+  void push(long ac) {
+    recent.push(ac > 32767 ? 32767 : (ac < -32768 ? -32768 : ac));
+  }
+
+  // Add the newest SHAPE samples (ending at a confident beat) to the
+  // template; it is built once learnBeats have been added
+  void learn() {
+    if (templateReady || !recent.full()) return;
+    for (uint8_t i = 0; i < SHAPE; i++) sums[i] += recent.at(i);
+    if (++learned == learnBeats) build();
+  }
+
+  bool ready() const { return templateReady; }
+
+  // Correlation (-100..100 %) of the newest SHAPE samples with the template
+  int8_t correlation() const {
+    if (!templateReady || !recent.full()) return 0;
+    int32_t dot = 0, sum = 0;
+    int64_t sumSquares = 0;
+    for (uint8_t i = 0; i < SHAPE; i++) {
+      int32_t x = recent.at(i);
+      dot += x * shape[i];  // The template has zero mean, so x needs no centring here
+      sum += x;
+      sumSquares += (int64_t)x * x;
+    }
+    float variance = (float)(sumSquares - (int64_t)sum * sum / SHAPE);
+    if (variance <= 0) return 0;
+    return (int8_t)lroundf(100.0f * dot / sqrtf(variance * shapeEnergy));
+  }
+
+private:
+  static_assert((int64_t)SHAPE * 32768 * 1024 <= 2147483647LL, "Template too long for a 32-bit dot product");
+
+  void build() {
+    long mean = 0;
+    for (uint8_t i = 0; i < SHAPE; i++) mean += sums[i];
+    mean /= SHAPE;
+    long peak = 0;
+    for (uint8_t i = 0; i < SHAPE; i++) {
+      long centred = sums[i] - mean;
+      if (centred > peak) peak = centred;
+      if (-centred > peak) peak = -centred;
+    }
+    if (peak == 0) {
+      learned = 0;  // A flat template matches nothing; start over
+      return;
+    }
+
+    shapeEnergy = 0;
+    for (uint8_t i = 0; i < SHAPE; i++) {
+      shape[i] = (int16_t)((sums[i] - mean) * 1024 / peak);
+      shapeEnergy += (float)shape[i] * shape[i];
+    }
+    templateReady = true;
+  }
+
+  uint8_t learnBeats;
+  HistoryRing<int16_t, SHAPE> recent;
+  long sums[SHAPE];  // Learned beats added up
+  uint8_t learned;
+  bool templateReady;
+  int16_t shape[SHAPE];
+  float shapeEnergy;
+};
+
+#endif // BEAT_TEMPLATE_H
@@ -6,19 +6,47 @@
 #include "MAX30105.h"
 #include <ArduinoJson.h>
 #include "config.h"  // Include configuration file
+#include "tick_scheduler.h"
+#include "spsc_ring.h"
+#include "max3010x_fifo.h"
+#include "interval_stats.h"
+#include "ppg_pipeline.h"
+#include "json_writer.h"
+#include "heap_alloc_counter.h"
+#include "ppg_frame_encoder.h"
+#include "history_ring.h"
+#include "running_stats.h"
+#include "hrv_stats.h"
+#include "spectral_hr.h"
+#include "signal_quality.h"
+#include "led_agc.h"
 
 // WiFi credentials from config.h
 const char* ssid = WIFI_SSID;
 const char* password = WIFI_PASSWORD;
 
 // Create web server on port from config.h
-ESP8266WebServer server(SERVER_PORT);
+ESP8266WebServer server(SensorConfig::serverPort);
 
-// Create WebSocket server on port 81
-WebSocketsServer webSocket = WebSocketsServer(81);
+// WebSocket server that can tell how much of a client's TCP send buffer is
+// free. Writing more than that blocks in WiFiClient until the client acks,
+// so data for slow clients is dropped instead (see clientHasRoom()).
+class SensorWebSocketsServer : public WebSocketsServer {
+public:
+  SensorWebSocketsServer(uint16_t port) : WebSocketsServer(port) {}
+  
+  size_t sendSpace(uint8_t num) {
+    if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || !_clients[num].tcp) return 0;
+    return _clients[num].tcp->availableForWrite();
+  }
+};
+
+// Create WebSocket server on port from config.h
+SensorWebSocketsServer webSocket(SensorConfig::websocketPort);
 
 // Initialize sensor
 MAX30105 particleSensor;
+Max3010xFifo sensorFifo(Wire, SensorConfig::ledMode);  // Burst reads of the sample FIFO
 
 // Timing variables
 unsigned long measurementStartTime = 0;
@@ -26,18 +54,87 @@ bool measurementActive = false;
 bool measurementComplete = false;
 
 // Beat detection variables
-unsigned long beatTimes[MAX_BEATS];
+HistoryRing<unsigned long, SensorConfig::maxBeats> beatTimes;  // ms since the start, newest maxBeats kept
+struct BeatRecord {
+  uint8_t spo2;          // SpO2 when the beat was detected
+  bool intervalCounted;  // The interval from the previous beat went into beatIntervals
+};
+HistoryRing<BeatRecord, SensorConfig::maxBeats> beatRecords;
 int beatCount = 0;
+unsigned long rejectedBeats = 0;  // Peaks dropped for poor signal quality
+bool beatSequenceBroken = false;  // A peak was rejected since the last recorded beat
+
+// Peaks wait here until the quality window they were found in has been
+// scored, so each is judged by its own stretch of signal, not the one before
+struct HeldBeat {
+  unsigned long timeMs;  // Sample time of the peak
+  unsigned long sample;  // Its sample index
+  float spo2;            // Unsmoothed SpO2 at the peak, 0 if none
+  uint8_t confidence;
+  bool candidate;        // False when dropped already (AGC settling, poor shape); it only breaks the sequence
+};
+HistoryRing<HeldBeat, SensorConfig::qualityWindow * SensorConfig::maxValidBpm / (60UL * SensorConfig::fifoSampleRate) + 2>
+  heldBeats;
 float calculatedBPM = 0;
-String lastBeatSystemTime = "";
 
-// Signal processing
-long irBuffer[BUFFER_SIZE];
-int bufferIndex = 0;
-long irDC = 0;    // DC component (baseline)
-long irACPrev = 0; // Previous AC value
-bool risingSlope = false;
-unsigned long lastBeatTime = 0;
+// HRV over the in-range beat intervals, updated per beat
+HrvStats hrv;
+
+// Early stop: a single measurement finishes once the 95% confidence
+// intervals of the mean heart rate (hrv.intervals()) and SpO2 are narrow enough
+RunningStats spo2Stats;                 // Unsmoothed SpO2 at each beat with a reading
+unsigned long measurementUsedMs = 0;    // How long the last measurement ran
+
+// Continuous monitoring: instead of one result after measurementDuration,
+// an estimate over the last continuousWindowMs is sent every
+// continuousReportMs until the measurement is stopped
+bool continuousMode = false;
+unsigned long windowFirstBeat = 0;   // Number of the oldest beat in the window (0 = first beat)
+unsigned long windowSpO2Sum = 0;     // SpO2 of the beats in the window with a reading
+uint16_t windowSpO2Count = 0;
+int windowSpO2 = 0;                  // SpO2 of the latest continuous_update
+unsigned long lastWindowReport = 0;  // Sample time of the latest continuous_update
+static_assert(SensorConfig::maxBeats > SensorConfig::continuousWindowMs / SensorConfig::minBeatInterval + 1,
+              "maxBeats cannot hold a continuous window of beats");
+unsigned long lastBeatSystemTime = 0;  // millis() of the last beat, 0 before the first
+
+// Beat-to-beat intervals, one histogram bin per sample period
+IntervalHistogram<SensorConfig::minBeatInterval, 60000 / SensorConfig::minValidBpm, 1000 / SensorConfig::fifoSampleRate> beatIntervals;
+
+// Signal processing (baseline, beat detection and SpO2), sized by config.h
+PpgPipeline<SensorConfig> ppg;
+LedAutoGain ledGain(adcFullScale(SensorConfig::pulseWidth), SensorConfig::agcTargetPercent,
+                    SensorConfig::agcTolerancePercent, SensorConfig::agcMinAmplitude, SensorConfig::ledBrightness,
+                    SensorConfig::adcRange, SensorConfig::agcBlockSamples, SensorConfig::agcWarmupSamples,
+                    SensorConfig::agcMinLevel);
+SignalQuality<SensorConfig::qualityWindow, SensorConfig::beatShapeSamples>
+  signalQuality(SensorConfig::minPerfusion, SensorConfig::maxPerfusion, SensorConfig::minSignalQuality);
+SpectralHeartRate<SensorConfig::fifoSampleRate, SensorConfig::spectralDecimation,
+                  SensorConfig::minValidBpm, SensorConfig::maxValidBpm> spectralHr;
+
+// Sample acquisition (FIFO burst reads)
+unsigned long sampleIndex = 0;     // Index of the next sample taken from the sensor FIFO
+unsigned long droppedSamples = 0;  // Samples lost to a sensor FIFO overflow
+long lastIrValue = 0;              // Most recent IR sample, used for broadcasts
+long lastRedValue = 0;             // Most recent Red sample, used for broadcasts
+
+// Raw samples of the current (or last) measurement for /waveform; the newest
+// waveformSamples are kept, and samples lost to a FIFO overflow are stored as 0
+struct WaveformSample {
+  uint32_t ir;
+  uint32_t red;
+};
+HistoryRing<WaveformSample, SensorConfig::waveformSamples> waveform;
+
+// FIFO-almost-full events from the sensor INT pin (sensorIntEnabled), stamped with micros() by the ISR
+SpscRing<unsigned long, 16> sensorEvents;
+unsigned long lastSensorEventTime = 0;   // millis() of the last serviced event
+unsigned long sensorEventTimeouts = 0;   // Times we read the FIFO without an interrupt
+unsigned long maxSensorEventLatency = 0; // Worst ISR-to-service delay in us
+
+void IRAM_ATTR onSensorInterrupt() {
+  sensorEvents.push(micros());
+}
 
 // Display variables
 int displayedBPM = 0;
@@ -45,13 +142,328 @@ int displayedSpO2 = 0;
 
 // WebSocket variables
 unsigned long lastBroadcastTime = 0;
-#define BROADCAST_INTERVAL 500 // Send data every 500ms
 
 // Status flag to indicate server availability
 bool serverBusy = false;
 
+// Fixed-rate tick for acquisition and DSP; network work uses the time left over
+TickScheduler sampleTick(SensorConfig::sampleTickUs);
+
 void processRealtimeMeasurement();
+void processSample(long irValue, long redValue, unsigned long currentTime);
 void broadcastSensorData();
+float currentMedianBPM();
+
+// Outgoing JSON is written into this preallocated buffer, after
+// messageHeadroom free bytes. The WebSocket library builds its frame header
+// in the last WEBSOCKETS_MAX_HEADER_SIZE of them instead of copying the
+// payload to the heap; Server-Sent Events put their "event:" line there.
+// The largest messages (measurement_complete, /health) need up to ~460
+// bytes with every counter at full width.
+const size_t messageHeadroom = 40;
+const size_t messageCapacity = 640;
+uint8_t messageBuffer[messageHeadroom + messageCapacity + 2];  // + SSE "\n\n" terminator
+const char* messageEvent = "";                                // Event name of the message being built
+unsigned long messageOverflows = 0;                           // Messages not sent because they outgrew messageCapacity
+
+JsonWriter newMessage() {
+  return JsonWriter((char*)messageBuffer + messageHeadroom, messageCapacity);
+}
+
+// Start a broadcast event; the name is also used as the SSE event type
+JsonWriter newEvent(const char* event) {
+  messageEvent = event;
+  JsonWriter json = newMessage();
+  json.field("event", event);
+  return json;
+}
+
+// Close the message. One that outgrew messageCapacity has lost fields, so
+// it is counted and logged rather than sent incomplete.
+bool finishMessage(JsonWriter& json) {
+  json.finish();
+  if (!json.overflowed()) return true;
+  messageOverflows++;
+  Serial.print("JSON message over capacity, not sent: ");
+  Serial.println(json.c_str());
+  return false;
+}
+
+uint8_t* webSocketFrame() {
+  return messageBuffer + messageHeadroom - WEBSOCKETS_MAX_HEADER_SIZE;
+}
+
+void sendMessage(uint8_t num, JsonWriter& json) {
+  if (!finishMessage(json)) return;
+  webSocket.sendTXT(num, webSocketFrame(), json.length(), true);
+}
+
+// What each WebSocket client receives, set with the subscribe command.
+// Every level includes the ones before it.
+enum SubscriptionLevel : uint8_t {
+  SUBSCRIBE_NONE,     // Not connected
+  SUBSCRIBE_STATUS,   // Command replies, finger_removed, measurement_complete
+  SUBSCRIBE_SUMMARY,  // + sensor_data every broadcastInterval
+  SUBSCRIBE_BEATS,    // + beat_detected (the default)
+  SUBSCRIBE_RAW       // Binary stream frames in place of the JSON events
+};
+const char* const subscriptionNames[] = { "none", "status", "summary", "beats", "raw" };
+
+uint8_t clientLevel[WEBSOCKETS_SERVER_CLIENT_MAX];
+unsigned long clientDrops[WEBSOCKETS_SERVER_CLIENT_MAX];  // Messages skipped because the client was too slow
+uint8_t streamClientCount = 0;                           // Clients at SUBSCRIBE_RAW
+
+// Binary stream for SUBSCRIBE_RAW clients. Raw samples, beat events and
+// status are batched into one frame (ppg_frame_encoder.h), sent when it is
+// full, batchMaxAgeMs after it was started, or straight away for urgent events.
+PpgFrameEncoder<SensorConfig::rawFrameSamples, SensorConfig::batchEventBytes, WEBSOCKETS_MAX_HEADER_SIZE> streamFrame(SensorConfig::fifoSampleRate);
+unsigned long streamFrameStartTime = 0;  // millis() when streamFrame was started, for the age flush
+
+// Server-Sent Events clients of /events, a read-only alternative to the WebSocket
+WiFiClient eventClients[SensorConfig::maxEventClients];
+unsigned long eventClientDrops = 0;
+unsigned long lastEventKeepAlive = 0;
+
+// Droppable data only goes to a client while its TCP send buffer would keep
+// clientSendReserve bytes free, so one slow client cannot stall acquisition
+bool clientHasRoom(uint8_t num, size_t length) {
+  if (webSocket.sendSpace(num) >= length + WEBSOCKETS_MAX_HEADER_SIZE + SensorConfig::clientSendReserve) return true;
+  clientDrops[num]++;
+  return false;
+}
+
+// Send the finished event to every /events client as
+// "event: <name>\ndata: <json>\n\n", framed around the JSON in messageBuffer
+void sendServerEvent(size_t jsonLength, bool droppable) {
+  size_t nameLength = strlen(messageEvent);
+  size_t prefixLength = 7 + nameLength + 7;
+  if (prefixLength > messageHeadroom) return;
+  
+  char* json = (char*)messageBuffer + messageHeadroom;
+  char* event = json - prefixLength;
+  memcpy(event, "event: ", 7);
+  memcpy(event + 7, messageEvent, nameLength);
+  memcpy(event + 7 + nameLength, "\ndata: ", 7);
+  json[jsonLength] = '\n';
+  json[jsonLength + 1] = '\n';
+  size_t eventLength = prefixLength + jsonLength + 2;
+  
+  for (uint8_t i = 0; i < SensorConfig::maxEventClients; i++) {
+    if (!eventClients[i].connected()) continue;
+    if (droppable && (size_t)eventClients[i].availableForWrite() < eventLength + SensorConfig::clientSendReserve) {
+      eventClientDrops++;
+      continue;
+    }
+    eventClients[i].write((const uint8_t*)event, eventLength);
+  }
+}
+
+// Events from newEvent() go to the WebSocket clients subscribed at minLevel
+// or above (except binary stream clients), then to the /events clients.
+// Anything above SUBSCRIBE_STATUS may be dropped for a slow client, and so
+// may everything while a measurement runs: the sample tick must never wait
+// on a client (continuous_update and finger_removed are sent mid-measurement).
+void broadcastMessage(JsonWriter& json, uint8_t minLevel) {
+  if (!finishMessage(json)) return;
+  bool droppable = minLevel > SUBSCRIBE_STATUS || measurementActive;
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    if (clientLevel[num] < minLevel || clientLevel[num] == SUBSCRIBE_RAW) continue;
+    if (droppable && !clientHasRoom(num, json.length())) continue;
+    webSocket.sendTXT(num, webSocketFrame(), json.length(), true);
+  }
+  sendServerEvent(json.length(), droppable);
+}
+
+// Comment line every eventKeepAliveMs so proxies keep idle /events streams open;
+// also releases clients that went away
+void keepServerEventsAlive() {
+  if (millis() - lastEventKeepAlive < SensorConfig::eventKeepAliveMs) return;
+  lastEventKeepAlive = millis();
+  
+  for (uint8_t i = 0; i < SensorConfig::maxEventClients; i++) {
+    if (eventClients[i].connected()) {
+      eventClients[i].write((const uint8_t*)": keep-alive\n\n", 14);
+    } else {
+      eventClients[i].stop();
+    }
+  }
+}
+
+uint8_t eventClientCount() {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < SensorConfig::maxEventClients; i++) {
+    if (eventClients[i].connected()) count++;
+  }
+  return count;
+}
+
+uint8_t webSocketClientCount() {
+  uint8_t count = 0;
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    if (clientLevel[num] != SUBSCRIBE_NONE) count++;
+  }
+  return count;
+}
+
+unsigned long totalClientDrops() {
+  unsigned long drops = 0;
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    drops += clientDrops[num];
+  }
+  return drops;
+}
+
+void sendJsonResponse(int code, JsonWriter& json) {
+  if (!finishMessage(json)) {
+    server.send(500, "application/json", "{\"status\":\"error\",\"message\":\"Response too large\"}");
+    return;
+  }
+  server.send(code, "application/json", json.c_str());
+}
+
+void setClientLevel(uint8_t num, uint8_t level) {
+  if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || clientLevel[num] == level) return;
+  if (level == SUBSCRIBE_RAW) {
+    streamClientCount++;
+  } else if (clientLevel[num] == SUBSCRIBE_RAW && --streamClientCount == 0) {
+    streamFrame.next(); // Nobody left to send the partial frame to
+  }
+  clientLevel[num] = level;
+}
+
+// Frames holding an urgent event are sent even to a congested client
+void flushStreamFrame(bool urgent = false) {
+  if (streamFrame.empty()) return;
+  
+  uint8_t* frame = streamFrame.frame();
+  for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++) {
+    if (clientLevel[num] != SUBSCRIBE_RAW) continue;
+    if (!urgent && !clientHasRoom(num, streamFrame.length())) continue;
+    webSocket.sendBIN(num, frame, streamFrame.length(), true);
+  }
+  streamFrame.next();
+  streamFrameStartTime = millis();
+}
+
+// Each add*() returns false when the frame is full (or a sample does not
+// follow on); the frame is then sent and the item added to the next one
+void streamSample(unsigned long index, uint32_t ir, uint32_t red) {
+  if (streamClientCount == 0) return;
+  if (!streamFrame.addSample(index, ir, red)) {
+    flushStreamFrame();
+    streamFrame.addSample(index, ir, red);
+  }
+  if (streamFrame.full()) {
+    flushStreamFrame();
+  }
+}
+
+void streamBeat(unsigned long index, uint16_t beats, uint16_t bpm) {
+  if (streamClientCount == 0) return;
+  if (!streamFrame.addBeat(index, beats, bpm)) {
+    flushStreamFrame();
+    streamFrame.addBeat(index, beats, bpm);
+  }
+}
+
+void streamStatus() {
+  if (streamClientCount == 0) return;
+  uint8_t flags = 0;
+  if (measurementActive) flags |= streamFrame.STATUS_ACTIVE;
+  if (measurementComplete) flags |= streamFrame.STATUS_COMPLETE;
+  if (lastIrValue > SensorConfig::fingerPresenceThreshold) flags |= streamFrame.STATUS_FINGER;
+  if (serverBusy) flags |= streamFrame.STATUS_BUSY;
+  uint16_t medianTenths = lround(currentMedianBPM() * 10);
+  if (!streamFrame.addStatus(displayedBPM, displayedSpO2, beatCount, medianTenths, flags)) {
+    flushStreamFrame();
+    streamFrame.addStatus(displayedBPM, displayedSpO2, beatCount, medianTenths, flags);
+  }
+}
+
+void streamContinuous(uint16_t bpmTenths, uint8_t spo2, uint16_t beatsInWindow, uint16_t windowSeconds) {
+  if (streamClientCount == 0) return;
+  if (!streamFrame.addContinuous(bpmTenths, spo2, beatsInWindow, windowSeconds, beatCount)) {
+    flushStreamFrame();
+    streamFrame.addContinuous(bpmTenths, spo2, beatsInWindow, windowSeconds, beatCount);
+  }
+}
+
+void streamQuality() {
+  if (streamClientCount == 0) return;
+  if (!streamFrame.addQuality(signalQuality.score(), signalQuality.perfusionIndex(),
+                              signalQuality.inBandPercent(), signalQuality.morphologyPercent())) {
+    flushStreamFrame();
+    streamFrame.addQuality(signalQuality.score(), signalQuality.perfusionIndex(),
+                           signalQuality.inBandPercent(), signalQuality.morphologyPercent());
+  }
+}
+
+// Urgent events go out at once, together with whatever the frame holds
+void streamFingerRemoved() {
+  if (streamClientCount == 0) return;
+  if (!streamFrame.addFingerRemoved()) {
+    flushStreamFrame();
+    streamFrame.addFingerRemoved();
+  }
+  flushStreamFrame(true);
+}
+
+void streamComplete() {
+  if (streamClientCount == 0) return;
+  uint16_t finalTenths = lround(calculatedBPM * 10);
+  if (!streamFrame.addComplete(finalTenths, displayedSpO2, beatCount)) {
+    flushStreamFrame();
+    streamFrame.addComplete(finalTenths, displayedSpO2, beatCount);
+  }
+  flushStreamFrame(true);
+}
+
+// Age flush, checked every tick. While the frame is empty its start time
+// follows the clock, so the age counts from (within a tick of) the first item.
+void flushStaleStreamFrame() {
+  if (streamFrame.empty()) {
+    streamFrameStartTime = millis();
+  } else if (millis() - streamFrameStartTime >= SensorConfig::batchMaxAgeMs) {
+    flushStreamFrame();
+  }
+}
+
+// Returns true when the FIFO should be read. In interrupt mode this only
+// happens after the sensor raised INT (or it has been silent for too long).
+bool sampleDataReady() {
+  if (!SensorConfig::sensorIntEnabled) return true;
+  
+  unsigned long eventMicros;
+  bool pending = false;
+  while (sensorEvents.pop(eventMicros)) {
+    unsigned long latency = micros() - eventMicros;
+    if (latency > maxSensorEventLatency) maxSensorEventLatency = latency;
+    pending = true;
+  }
+  
+  if (!pending) {
+    if (millis() - lastSensorEventTime < SensorConfig::sensorIntTimeoutMs) return false;
+    sensorEventTimeouts++; // Missed edge; fall back to reading the FIFO anyway
+  }
+  
+  // Reading the status register releases the INT line for the next edge
+  particleSensor.getINT1();
+  lastSensorEventTime = millis();
+  return true;
+}
+
+// Median BPM over the intervals recorded so far, 0 before the second beat
+float currentMedianBPM() {
+  unsigned long medianInterval = beatIntervals.median();
+  return medianInterval > 0 ? 60000.0 / medianInterval : 0;
+}
+
+// Convert a FIFO sample index into milliseconds since the measurement started. The sample period is a
+// whole number of ms (asserted in PpgPipeline), so this wraps after 2^32 ms like millis(), where
+// index * 1000 would wrap after 2^32 / 1000 samples (12 h at 100 Hz)
+unsigned long sampleTimeMs(unsigned long index) {
+  return index * (1000 / SensorConfig::fifoSampleRate);
+}
 
 // New function to clear measurement results
 void clearMeasurementResults() {
@@ -60,32 +472,64 @@ void clearMeasurementResults() {
   Serial.println("Measurement results cleared");
   
   // Return success response
-  DynamicJsonDocument doc(256);
-  doc["status"] = "success";
-  doc["message"] = "Measurement results cleared";
-  
-  String response;
-  serializeJson(doc, response);
+  JsonWriter json = newMessage();
+  json.field("status", "success");
+  json.field("message", "Measurement results cleared");
   
-  server.send(200, "application/json", response);
+  sendJsonResponse(200, json);
 }
 
 void resetMeasurement() {
   measurementActive = false;
   measurementComplete = false;
+  continuousMode = false;
   beatCount = 0;
-  lastBeatSystemTime = "";
+  lastBeatSystemTime = 0;
 }
 
-void startMeasurement() {
+void startMeasurement(bool continuous = false) {
   Serial.println("\n--- STARTING NEW MEASUREMENT ---");
-  Serial.println("Hold your finger still for 60 seconds");
+  if (continuous) {
+    Serial.println("Continuous monitoring, updated every " + String(SensorConfig::continuousReportMs / 1000) + " seconds");
+  } else {
+    Serial.println("Hold your finger still for " + String(SensorConfig::measurementDuration / 1000) + " seconds");
+  }
   
   // Reset variables
   beatCount = 0;
   calculatedBPM = 0;
-  irACPrev = 0;
-  risingSlope = false;
+  beatTimes.reset();
+  beatRecords.reset();
+  rejectedBeats = 0;
+  beatSequenceBroken = false;
+  heldBeats.reset();
+  signalQuality.reset();
+  beatIntervals.reset();
+  hrv.reset();
+  spo2Stats.reset();
+  measurementUsedMs = 0;
+  ppg.reset();
+  spectralHr.reset();
+  if (SensorConfig::ledAgc) {
+    ledGain.start();
+  }
+  continuousMode = continuous;
+  windowFirstBeat = 0;
+  windowSpO2Sum = 0;
+  windowSpO2Count = 0;
+  windowSpO2 = 0;
+  lastWindowReport = 0;
+  
+  // Start sampling from an empty FIFO so sample 0 lines up with the start time
+  particleSensor.clearFIFO();
+  sampleIndex = 0;
+  droppedSamples = 0;
+  streamFrame.reset();
+  waveform.reset();
+  if (SensorConfig::sensorIntEnabled) {
+    particleSensor.getINT1(); // Release an INT left asserted while idle
+    lastSensorEventTime = millis();
+  }
   
   // Set timing
   measurementStartTime = millis();
@@ -93,82 +537,177 @@ void startMeasurement() {
   measurementComplete = false;
 }
 
+void applyLedSettings() {
+  particleSensor.setPulseAmplitudeIR(ledGain.irAmplitude());
+  particleSensor.setPulseAmplitudeRed(ledGain.redAmplitude());
+  particleSensor.setADCRange(ledGain.adcRangeBits());
+}
+
+// Time of beat number n (0 = first beat); n must still be held in beatTimes
+unsigned long beatTime(unsigned long n) {
+  return beatTimes.at(n - (beatTimes.total() - beatTimes.size()));
+}
+
+const BeatRecord& beatRecord(unsigned long n) {
+  return beatRecords.at(n - (beatRecords.total() - beatRecords.size()));
+}
+
+unsigned long windowBeats() {
+  return beatCount - windowFirstBeat;
+}
+
+// Heart rate over the beats from windowFirstBeat on (the whole measurement
+// unless in continuous mode); 0 with fewer than 3 beats or no valid rate
+float windowBPM(float& medianBPM, float& averageBPM) {
+  medianBPM = 0;
+  averageBPM = 0;
+  if (windowBeats() < 3) return 0;
+  
+  // Median heart rate filters outliers; intervals were binned as beats arrived
+  medianBPM = currentMedianBPM();
+  
+  // Also calculate average-based BPM, over the counted intervals only so
+  // stretches of rejected beats don't drag it down
+  averageBPM = beatIntervals.mean() > 0 ? 60000.0 / beatIntervals.mean() : 0;
+  
+  // Use the median BPM if it's reasonable, otherwise fall back to average
+  float bpm;
+  if (medianBPM >= SensorConfig::minValidBpm && medianBPM <= SensorConfig::maxValidBpm) {
+    bpm = medianBPM;
+  } else {
+    bpm = averageBPM;
+  }
+  
+  // Apply final sanity check
+  if (bpm < SensorConfig::minValidBpm || bpm > SensorConfig::maxValidBpm) {
+    bpm = 0;
+  }
+  return bpm;
+}
+
+// Continuous mode: drop beats older than continuousWindowMs (keeping at
+// least the newest) along with their interval and SpO2 reading
+void slideBeatWindow(unsigned long now) {
+  while (windowFirstBeat + 1 < (unsigned long)beatCount &&
+         now - beatTime(windowFirstBeat) > SensorConfig::continuousWindowMs) {
+    if (beatRecord(windowFirstBeat + 1).intervalCounted) {
+      beatIntervals.remove(beatTime(windowFirstBeat + 1) - beatTime(windowFirstBeat));
+    }
+    uint8_t spo2 = beatRecord(windowFirstBeat).spo2;
+    if (spo2 > 0) {
+      windowSpO2Sum -= spo2;
+      windowSpO2Count--;
+    }
+    windowFirstBeat++;
+  }
+}
+
+void reportWindow(unsigned long now) {
+  float medianBPM, averageBPM;
+  calculatedBPM = windowBPM(medianBPM, averageBPM);
+  windowSpO2 = windowSpO2Count > 0 ? (windowSpO2Sum + windowSpO2Count / 2) / windowSpO2Count : 0;
+  unsigned long windowMs = now < SensorConfig::continuousWindowMs ? now : SensorConfig::continuousWindowMs;
+  
+  Serial.print("Window BPM: ");
+  Serial.print(calculatedBPM);
+  Serial.print(", SpO2: ");
+  Serial.print(windowSpO2);
+  Serial.print(", beats in window: ");
+  Serial.println(windowBeats());
+  
+  JsonWriter json = newEvent("continuous_update");
+  json.fieldAsString("timestamp", millis());
+  json.fieldTenths("heart_rate", lround(calculatedBPM * 10));
+  json.field("spo2", windowSpO2);
+  json.field("beats_in_window", windowBeats());
+  json.field("window_seconds", windowMs / 1000);
+  json.field("beats_detected", beatCount);
+  
+  broadcastMessage(json, SUBSCRIBE_STATUS);
+  streamContinuous(lround(calculatedBPM * 10), windowSpO2, windowBeats(), windowMs / 1000);
+}
+
+void finishMeasurement();
+
+// End a running measurement now; false if none is running
+bool stopMeasurement() {
+  if (!measurementActive) return false;
+  finishMeasurement();
+  serverBusy = false;
+  return true;
+}
+
+// The estimate is precise enough to stop a single measurement before
+// measurementDuration
+bool estimateConverged() {
+  if (!SensorConfig::earlyStop) return false;
+  if (millis() - measurementStartTime < SensorConfig::earlyStopMinMs) return false;
+  const RunningStats& intervalStats = hrv.intervals();
+  if (intervalStats.count() < SensorConfig::earlyStopMinBeats ||
+      spo2Stats.count() < SensorConfig::earlyStopMinBeats) return false;
+  
+  // Heart rate is 60000 / interval, so its CI is the interval CI scaled by 60000 / mean^2
+  float meanMs = intervalStats.mean();
+  float bpmCi = 60000.0 * intervalStats.ci95() / (meanMs * meanMs);
+  return bpmCi <= SensorConfig::earlyStopBpmCi && spo2Stats.ci95() <= SensorConfig::earlyStopSpo2Ci;
+}
+
 void finishMeasurement() {
   measurementActive = false;
   measurementComplete = true;
+  measurementUsedMs = millis() - measurementStartTime;
   
   // Calculate accurate BPM based on collected data
-  if (beatCount >= 3) {
-    // Calculate time elapsed between first and last beat
-    unsigned long totalMeasurementTime = beatTimes[beatCount - 1] - beatTimes[0];
-    
-    // First, calculate all beat-to-beat intervals
-    unsigned long beatIntervals[MAX_BEATS-1];
-    int intervalCount = 0;
-    
-    for (int i = 1; i < beatCount; i++) {
-      beatIntervals[intervalCount++] = beatTimes[i] - beatTimes[i-1];
-    }
-    
-    // Calculate median heart rate to filter outliers
-    // Simple selection sort for this small array
-    for (int i = 0; i < intervalCount - 1; i++) {
-      for (int j = i + 1; j < intervalCount; j++) {
-        if (beatIntervals[i] > beatIntervals[j]) {
-          unsigned long temp = beatIntervals[i];
-          beatIntervals[i] = beatIntervals[j];
-          beatIntervals[j] = temp;
-        }
-      }
-    }
-    
-    // Get median interval
-    unsigned long medianInterval;
-    if (intervalCount % 2 == 0) {
-      medianInterval = (beatIntervals[intervalCount/2] + beatIntervals[intervalCount/2 - 1]) / 2;
-    } else {
-      medianInterval = beatIntervals[intervalCount/2];
-    }
-    
-    // Convert to BPM
-    float medianBPM = 60000.0 / medianInterval;
-    
-    // Also calculate average-based BPM
-    float minutesElapsed = totalMeasurementTime / 60000.0;
-    float averageBPM = (beatCount - 1) / minutesElapsed;
-    
-    // Use the median BPM if it's reasonable, otherwise fall back to average
-    if (medianBPM >= MIN_VALID_BPM && medianBPM <= MAX_VALID_BPM) {
-      calculatedBPM = medianBPM;
-    } else {
-      calculatedBPM = averageBPM;
-    }
-    
-    // Apply final sanity check
-    if (calculatedBPM < MIN_VALID_BPM || calculatedBPM > MAX_VALID_BPM) {
-      calculatedBPM = 0;
-    }
-    
+  float medianBPM, averageBPM;
+  calculatedBPM = windowBPM(medianBPM, averageBPM);
+  if (windowBeats() >= 3) {
     Serial.print("Measurement complete. Median BPM: ");
     Serial.print(medianBPM);
     Serial.print(", Average BPM: ");
     Serial.print(averageBPM);
     Serial.print(", Final BPM: ");
     Serial.println(calculatedBPM);
+    Serial.print("Measurement time (s): ");
+    Serial.println(measurementUsedMs / 1000.0);
+    Serial.print("Samples processed: ");
+    Serial.print(sampleIndex);
+    Serial.print(", dropped: ");
+    Serial.print(droppedSamples);
+    Serial.print(", missed ticks: ");
+    Serial.print(sampleTick.missedDeadlines());
+    Serial.print(", I2C errors: ");
+    Serial.println(sensorFifo.busErrors());
+    if (SensorConfig::sensorIntEnabled) {
+      Serial.print("Sensor INT timeouts: ");
+      Serial.print(sensorEventTimeouts);
+      Serial.print(", max INT latency (us): ");
+      Serial.println(maxSensorEventLatency);
+    }
   } else {
-    calculatedBPM = 0; // Not enough beats detected
+    // Not enough beats detected
     Serial.println("Measurement complete, but not enough beats detected for accurate calculation.");
   }
   
+  // Cross-check with the spectral estimate, which doesn't depend on finding
+  // individual peaks: it stands in when beat counting gave no valid rate or
+  // disagrees, provided its spectrum has a clear peak
+  float spectralBPM = spectralHr.bpm();
+  if (SensorConfig::spectralHr && spectralBPM > 0) {
+    bool agree = calculatedBPM > 0 &&
+                 fabs(spectralBPM - calculatedBPM) <= calculatedBPM * SensorConfig::hrCrossCheckPercent / 100;
+    Serial.print("Spectral BPM: ");
+    Serial.print(spectralBPM);
+    Serial.print(", peak share: ");
+    Serial.print(spectralHr.peakShare());
+    Serial.println(agree ? "% (agrees)" : "% (disagrees)");
+    if (!agree && spectralHr.peakShare() >= SensorConfig::spectralMinPeakShare) {
+      calculatedBPM = spectralBPM;
+    }
+  }
+  
   // Broadcast final results via WebSocket
   broadcastSensorData();
-}
-
-// Get current timestamp in ISO8601 format
-String getISOTimestamp() {
-  // This is a simplified version since ESP8266 doesn't have a real-time clock
-  // In a real application, you would use NTP to get the actual time
-  return String(millis());
+  streamComplete();
 }
 
 // Improve WebSocket event handler to prioritize ping responses
@@ -176,24 +715,25 @@ void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length
   switch(type) {
     case WStype_DISCONNECTED:
       Serial.printf("[%u] Disconnected!\n", num);
+      setClientLevel(num, SUBSCRIBE_NONE);
       break;
     case WStype_CONNECTED:
       {
         IPAddress ip = webSocket.remoteIP(num);
         Serial.printf("[%u] Connected from %d.%d.%d.%d url: %s\n", num, ip[0], ip[1], ip[2], ip[3], payload);
+        setClientLevel(num, SUBSCRIBE_BEATS);
+        clientDrops[num] = 0;
         
         // Send welcome message
-        DynamicJsonDocument doc(256);
-        doc["event"] = "connected";
-        doc["status"] = "ok";
-        doc["message"] = "Connected to ESP8266 Heart Rate Monitor";
-        doc["server_busy"] = serverBusy;
-        doc["measurement_active"] = measurementActive;
-        doc["measurement_complete"] = measurementComplete;
+        JsonWriter json = newMessage();
+        json.field("event", "connected");
+        json.field("status", "ok");
+        json.field("message", "Connected to ESP8266 Heart Rate Monitor");
+        json.field("server_busy", serverBusy);
+        json.field("measurement_active", measurementActive);
+        json.field("measurement_complete", measurementComplete);
         
-        String response;
-        serializeJson(doc, response);
-        webSocket.sendTXT(num, response);
+        sendMessage(num, json);
       }
       break;
     case WStype_TEXT:
@@ -205,64 +745,108 @@ void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length
         DeserializationError error = deserializeJson(doc, payload);
         
         if (!error) {
-          String command = doc["command"];
+          const char* command = doc["command"] | "";
           
           // Give highest priority to ping - respond immediately
-          if (command == "ping") {
+          if (strcmp(command, "ping") == 0) {
             // Respond to ping with a pong to confirm connection is alive
-            DynamicJsonDocument pongDoc(256);
-            pongDoc["event"] = "pong";
-            pongDoc["timestamp"] = getISOTimestamp();
-            pongDoc["server_busy"] = serverBusy;
-            pongDoc["measurement_active"] = measurementActive;
+            JsonWriter json = newMessage();
+            json.field("event", "pong");
+            json.fieldAsString("timestamp", millis());
+            json.field("server_busy", serverBusy);
+            json.field("measurement_active", measurementActive);
             
-            String pongResponse;
-            serializeJson(pongDoc, pongResponse);
-            webSocket.sendTXT(num, pongResponse);
+            sendMessage(num, json);
             
             // Exit after responding to ping to prioritize response time
             return;
           }
-          else if (command == "start_measurement") {
+          else if (strcmp(command, "start_measurement") == 0) {
             // Only start if not already busy
             if (!serverBusy && !measurementActive) {
-              // Reset and start a new measurement
+              // Reset and start a new measurement; "mode": "continuous" runs until stop_measurement
+              bool continuous = strcmp(doc["mode"] | "", "continuous") == 0;
               resetMeasurement();
-              startMeasurement();
+              startMeasurement(continuous);
               
               // Send acknowledgment
-              DynamicJsonDocument responseDoc(256);
-              responseDoc["event"] = "measurement_started";
-              responseDoc["timestamp"] = getISOTimestamp();
+              JsonWriter json = newMessage();
+              json.field("event", "measurement_started");
+              json.field("mode", continuous ? "continuous" : "single");
+              json.fieldAsString("timestamp", millis());
               
-              String response;
-              serializeJson(responseDoc, response);
-              webSocket.sendTXT(num, response);
+              sendMessage(num, json);
             } else {
               // Send busy message
-              DynamicJsonDocument busyDoc(256);
-              busyDoc["event"] = "error";
-              busyDoc["message"] = "Server is busy with another measurement";
-              busyDoc["timestamp"] = getISOTimestamp();
+              JsonWriter json = newMessage();
+              json.field("event", "error");
+              json.field("message", "Server is busy with another measurement");
+              json.fieldAsString("timestamp", millis());
               
-              String busyResponse;
-              serializeJson(busyDoc, busyResponse);
-              webSocket.sendTXT(num, busyResponse);
+              sendMessage(num, json);
             }
           }
-          else if (command == "check_status") {
+          else if (strcmp(command, "stop_measurement") == 0) {
+            // Finish early; the result goes out as measurement_complete
+            if (!stopMeasurement()) {
+              JsonWriter json = newMessage();
+              json.field("event", "error");
+              json.field("message", "No measurement in progress");
+              json.fieldAsString("timestamp", millis());
+              
+              sendMessage(num, json);
+            }
+          }
+          else if (strcmp(command, "check_status") == 0) {
             // Send current status
-            DynamicJsonDocument statusDoc(256);
-            statusDoc["event"] = "status";
-            statusDoc["timestamp"] = getISOTimestamp();
-            statusDoc["server_busy"] = serverBusy;
-            statusDoc["measurement_active"] = measurementActive;
-            statusDoc["measurement_complete"] = measurementComplete;
-            statusDoc["beats_detected"] = beatCount;
+            JsonWriter json = newMessage();
+            json.field("event", "status");
+            json.fieldAsString("timestamp", millis());
+            json.field("server_busy", serverBusy);
+            json.field("measurement_active", measurementActive);
+            json.field("measurement_complete", measurementComplete);
+            json.field("beats_detected", beatCount);
+            json.field("subscription", subscriptionNames[clientLevel[num]]);
+            json.field("dropped_messages", clientDrops[num]);
+            
+            sendMessage(num, json);
+          }
+          else if (strcmp(command, "subscribe") == 0) {
+            // Choose what this client receives: status, summary, beats or raw
+            const char* level = doc["level"] | "";
+            uint8_t newLevel = SUBSCRIBE_NONE;
+            for (uint8_t i = SUBSCRIBE_STATUS; i <= SUBSCRIBE_RAW; i++) {
+              if (strcmp(level, subscriptionNames[i]) == 0) newLevel = i;
+            }
+            
+            JsonWriter json = newMessage();
+            if (newLevel == SUBSCRIBE_NONE) {
+              json.field("event", "error");
+              json.field("message", "Unknown subscription level");
+            } else {
+              setClientLevel(num, newLevel);
+              json.field("event", "subscribed");
+              json.field("level", subscriptionNames[newLevel]);
+              if (newLevel == SUBSCRIBE_RAW) {
+                json.field("sample_rate", SensorConfig::fifoSampleRate);
+                json.field("frame_samples", SensorConfig::rawFrameSamples);
+              }
+            }
             
-            String statusResponse;
-            serializeJson(statusDoc, statusResponse);
-            webSocket.sendTXT(num, statusResponse);
+            sendMessage(num, json);
+          }
+          else if (strcmp(command, "stream_raw") == 0) {
+            // Shorthand for subscribing to raw (or back to beats)
+            bool enabled = doc["enabled"] | true;
+            setClientLevel(num, enabled ? SUBSCRIBE_RAW : SUBSCRIBE_BEATS);
+            
+            JsonWriter json = newMessage();
+            json.field("event", "stream_raw");
+            json.field("enabled", enabled);
+            json.field("sample_rate", SensorConfig::fifoSampleRate);
+            json.field("frame_samples", SensorConfig::rawFrameSamples);
+            
+            sendMessage(num, json);
           }
         }
       }
@@ -272,137 +856,423 @@ void webSocketEvent(uint8_t num, WStype_t type, uint8_t * payload, size_t length
 
 // Broadcast sensor data to all connected clients
 void broadcastSensorData() {
-  DynamicJsonDocument doc(512);
-  doc["event"] = "sensor_data";
-  doc["timestamp"] = getISOTimestamp();
-  doc["heart_rate"] = displayedBPM;
-  doc["spo2"] = displayedSpO2;
-  doc["measurement_active"] = measurementActive;
-  doc["beats_detected"] = beatCount;
-  doc["server_busy"] = serverBusy;
+  JsonWriter json = newEvent(measurementComplete ? "measurement_complete" : "sensor_data");
+  json.fieldAsString("timestamp", millis());
+  json.field("heart_rate", displayedBPM);
+  json.field("spo2", displayedSpO2);
+  json.field("measurement_active", measurementActive);
+  json.field("beats_detected", beatCount);
+  json.fieldTenths("median_bpm", lround(currentMedianBPM() * 10));
+  json.field("signal_quality", signalQuality.score());
+  json.fieldTenths("perfusion_index", signalQuality.perfusionIndex() / 10);
+  json.field("server_busy", serverBusy);
   
   // Add more data for final result
   if (measurementComplete) {
-    doc["event"] = "measurement_complete";
-    doc["final_heart_rate"] = round(calculatedBPM * 10) / 10.0;
+    json.fieldTenths("final_heart_rate", lround(calculatedBPM * 10));
+    json.fieldTenths("measurement_seconds", measurementUsedMs / 100);
+    json.fieldTenths("spectral_heart_rate", lround(spectralHr.bpm() * 10));
+    json.fieldTenths("rmssd", lround(hrv.rmssd() * 10));
+    json.fieldTenths("sdnn", lround(hrv.sdnn() * 10));
+    json.fieldTenths("pnn50", lround(hrv.pnn50() * 10));
+    json.field("rejected_beats", rejectedBeats);
   }
   
-  // Add raw sensor data if needed
-  long irValue = particleSensor.getIR();
-  long redValue = particleSensor.getRed();
-  doc["ir_value"] = irValue;
-  doc["red_value"] = redValue;
+  // Add the latest raw samples (reading the sensor here would steal samples from the FIFO)
+  json.field("ir_value", lastIrValue);
+  json.field("red_value", lastRedValue);
   
   // Calculate finger presence
-  bool fingerPresent = irValue > FINGER_PRESENCE_THRESHOLD;
-  doc["finger_present"] = fingerPresent;
+  bool fingerPresent = lastIrValue > SensorConfig::fingerPresenceThreshold;
+  json.field("finger_present", fingerPresent);
   
-  String response;
-  serializeJson(doc, response);
-  webSocket.broadcastTXT(response);
+  broadcastMessage(json, measurementComplete ? SUBSCRIBE_STATUS : SUBSCRIBE_SUMMARY);
+  streamStatus();
 }
 
 // Handle health check endpoint with priority
 void handleHealth() {
   // This function needs to respond quickly
-  DynamicJsonDocument doc(256);
-  doc["status"] = "UP";
-  doc["timestamp"] = getISOTimestamp();
-  doc["message"] = "ESP Sensor is running";
-  doc["websocket_port"] = 81;  // Add WebSocket info
-  doc["server_busy"] = serverBusy;
-  doc["measurement_active"] = measurementActive;
-  
-  String response;
-  serializeJson(doc, response);
+  JsonWriter json = newMessage();
+  json.field("status", "UP");
+  json.fieldAsString("timestamp", millis());
+  json.field("message", "ESP Sensor is running");
+  json.field("websocket_port", SensorConfig::websocketPort);  // Add WebSocket info
+  json.field("server_busy", serverBusy);
+  json.field("measurement_active", measurementActive);
+  json.field("missed_deadlines", sampleTick.missedDeadlines());
+  json.field("max_tick_lateness_us", sampleTick.maxLatenessUs());
+  json.field("i2c_errors", sensorFifo.busErrors());
+  json.field("led_amplitude_ir", ledGain.irAmplitude());
+  json.field("led_amplitude_red", ledGain.redAmplitude());
+  json.field("adc_range_na", ledGain.adcRangeNa());
+  json.field("websocket_clients", webSocketClientCount());
+  json.field("websocket_drops", totalClientDrops());
+  json.field("event_clients", eventClientCount());
+  json.field("event_drops", eventClientDrops);
+  json.field("message_overflows", messageOverflows);
+  if (heapAllocationsTracked) {
+    json.field("loop_heap_allocs", scopedHeapAllocations);
+  }
   
-  server.send(200, "application/json", response);
+  sendJsonResponse(200, json);
 }
 
 // Handle beat data endpoint
 void handleBeat() {
-  DynamicJsonDocument doc(256);
-  doc["lastBeatTime"] = lastBeatSystemTime;
-  doc["measurementActive"] = measurementActive;
-  doc["beatsDetected"] = beatCount;
-  doc["server_busy"] = serverBusy;
-  
-  String response;
-  serializeJson(doc, response);
+  JsonWriter json = newMessage();
+  if (lastBeatSystemTime > 0) {
+    json.fieldAsString("lastBeatTime", lastBeatSystemTime);
+  } else {
+    json.field("lastBeatTime", "");
+  }
+  json.field("measurementActive", measurementActive);
+  json.field("beatsDetected", beatCount);
+  json.fieldTenths("medianBPM", lround(currentMedianBPM() * 10));
+  json.field("server_busy", serverBusy);
   
-  server.send(200, "application/json", response);
+  sendJsonResponse(200, json);
 }
 
 // Handle non-blocking readings
 void handleReadings() {
   // Check if a measurement is already in progress
   if (measurementActive || serverBusy) {
-    DynamicJsonDocument doc(256);
-    doc["status"] = "error";
-    doc["message"] = "Measurement in progress. Please wait.";
+    JsonWriter json = newMessage();
+    json.field("status", "error");
+    json.field("message", "Measurement in progress. Please wait.");
     
-    String response;
-    serializeJson(doc, response);
-    
-    server.send(400, "application/json", response);
+    sendJsonResponse(400, json);
     return;
   }
   
-  // Reset and start a new measurement
+  // Reset and start a new measurement; ?mode=continuous runs until /stop
+  bool continuous = server.arg("mode") == "continuous";
   resetMeasurement();
-  startMeasurement();
+  startMeasurement(continuous);
   serverBusy = true; // Mark server as busy
   
   // Return immediately with acknowledgment that measurement has started
-  DynamicJsonDocument doc(256);
-  doc["status"] = "started";
-  doc["message"] = "60-second measurement started. Check /beat for progress.";
-  doc["timestamp"] = getISOTimestamp();
-  
-  String response;
-  serializeJson(doc, response);
+  JsonWriter json = newMessage();
+  json.field("status", "started");
+  if (continuous) {
+    json.field("message", "Continuous measurement started. Check /results for the latest estimate and /stop to end it.");
+  } else {
+    json.field("message", "60-second measurement started. Check /beat for progress.");
+  }
+  json.fieldAsString("timestamp", millis());
   
-  server.send(200, "application/json", response);
+  sendJsonResponse(200, json);
+}
+
+// End a running measurement early, e.g. a continuous one
+void handleStop() {
+  JsonWriter json = newMessage();
+  if (stopMeasurement()) {
+    json.field("status", "stopped");
+    json.fieldTenths("heartRate", lround(calculatedBPM * 10));
+    json.field("spo2", displayedSpO2);
+    json.field("beatsDetected", beatCount);
+    json.fieldTenths("measurementSeconds", measurementUsedMs / 100);
+    json.fieldAsString("timestamp", millis());
+    
+    sendJsonResponse(200, json);
+  } else {
+    json.field("status", "error");
+    json.field("message", "No measurement in progress");
+    
+    sendJsonResponse(400, json);
+  }
 }
 
 // New endpoint for results
 void handleReadingResults() {
-  DynamicJsonDocument doc(256);
+  JsonWriter json = newMessage();
   
   if (measurementComplete) {
-    doc["status"] = "success";
-    doc["heartRate"] = round(calculatedBPM * 10) / 10.0;
-    doc["spo2"] = round(displayedSpO2 * 10) / 10.0;
-    doc["beatsDetected"] = beatCount;
-    doc["timestamp"] = getISOTimestamp();
-    doc["server_busy"] = serverBusy;
+    json.field("status", "success");
+    json.fieldTenths("heartRate", lround(calculatedBPM * 10));
+    json.field("spo2", displayedSpO2);
+    json.field("beatsDetected", beatCount);
+    json.fieldTenths("measurementSeconds", measurementUsedMs / 100);
+    json.fieldTenths("rmssd", lround(hrv.rmssd() * 10));
+    json.fieldTenths("sdnn", lround(hrv.sdnn() * 10));
+    json.fieldTenths("pnn50", lround(hrv.pnn50() * 10));
+    json.field("rejectedBeats", rejectedBeats);
+    json.fieldAsString("timestamp", millis());
+    json.field("server_busy", serverBusy);
     
     // Don't reset the complete flag here anymore
     // We'll let the client explicitly clear it with the new endpoint
+  } else if (continuousMode && measurementActive && lastWindowReport > 0) {
+    // Latest sliding-window estimate of a continuous measurement
+    json.field("status", "continuous");
+    json.fieldTenths("heartRate", lround(calculatedBPM * 10));
+    json.field("spo2", windowSpO2);
+    json.field("beatsInWindow", windowBeats());
+    json.field("beatsDetected", beatCount);
+    json.fieldAsString("timestamp", millis());
+    json.field("server_busy", serverBusy);
   } else {
-    doc["status"] = "not_ready";
-    doc["message"] = "No completed measurement available";
-    doc["measurement_active"] = measurementActive;
-    doc["server_busy"] = serverBusy;
+    json.field("status", "not_ready");
+    json.field("message", "No completed measurement available");
+    json.field("measurement_active", measurementActive);
+    json.field("server_busy", serverBusy);
   }
   
-  String response;
-  serializeJson(doc, response);
+  sendJsonResponse(200, json);
+}
+
+// Keep the connection open as a Server-Sent Events stream. The client is
+// kept in eventClients after the handler returns; the web server never sends
+// a response of its own for it.
+void handleEvents() {
+  for (uint8_t i = 0; i < SensorConfig::maxEventClients; i++) {
+    if (eventClients[i].connected()) continue;
+    
+    static const char headers[] =
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: text/event-stream\r\n"
+      "Cache-Control: no-cache\r\n"
+      "Connection: keep-alive\r\n"
+      "Access-Control-Allow-Origin: *\r\n"
+      "\r\n"
+      "retry: 3000\n\n";
+    eventClients[i] = server.client();
+    eventClients[i].write((const uint8_t*)headers, sizeof(headers) - 1);
+    Serial.printf("SSE client %u connected\n", i);
+    return;
+  }
+  
+  JsonWriter json = newMessage();
+  json.field("status", "error");
+  json.field("message", "Too many event stream clients");
+  
+  sendJsonResponse(503, json);
+}
+
+// Writes a response body in HTTP chunks of at most one message buffer, so
+// large responses never need a String of their own
+class ChunkedResponse {
+public:
+  ChunkedResponse() : buffer((char*)messageBuffer), used(0) {}
+  
+  void begin(int code, const char* contentType) {
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server.send(code, contentType, "");
+  }
+  
+  void print(const char* text) {
+    while (*text) {
+      if (used == sizeof(messageBuffer)) flush();
+      buffer[used++] = *text++;
+    }
+  }
+  
+  void print(unsigned long value) {
+    char digits[11];
+    print(ultoa(value, digits, 10));
+  }
+  
+  void end() {
+    flush();
+    server.sendContent(""); // Zero-length chunk ends the response
+  }
+  
+private:
+  void flush() {
+    if (used > 0) server.sendContent(buffer, used);
+    used = 0;
+  }
   
-  server.send(200, "application/json", response);
+  char* buffer;
+  size_t used;
+};
+
+// Stream the raw samples and beat times of the last measurement
+void handleWaveform() {
+  if (measurementActive) {
+    // Sending takes longer than the sensor FIFO can buffer
+    JsonWriter json = newMessage();
+    json.field("status", "error");
+    json.field("message", "Measurement in progress. Please wait.");
+    
+    sendJsonResponse(409, json);
+    return;
+  }
+  if (waveform.size() == 0) {
+    JsonWriter json = newMessage();
+    json.field("status", "not_ready");
+    json.field("message", "No measurement waveform available");
+    
+    sendJsonResponse(200, json);
+    return;
+  }
+  
+  ChunkedResponse response;
+  response.begin(200, "application/json");
+  response.print("{\"status\":\"success\",\"sample_rate\":");
+  response.print((unsigned long)SensorConfig::fifoSampleRate);
+  response.print(",\"first_sample\":");
+  response.print(waveform.total() - waveform.size());
+  response.print(",\"dropped_samples\":");
+  response.print(droppedSamples);
+  
+  // [ir, red] pairs, oldest first
+  response.print(",\"samples\":[");
+  for (uint16_t i = 0; i < waveform.size(); i++) {
+    const WaveformSample& sample = waveform.at(i);
+    response.print(i == 0 ? "[" : ",[");
+    response.print((unsigned long)sample.ir);
+    response.print(",");
+    response.print((unsigned long)sample.red);
+    response.print("]");
+  }
+  
+  // Beat times in ms since the measurement started (sample index * 1000 / sample_rate)
+  response.print("],\"beats\":[");
+  for (uint16_t i = 0; i < beatTimes.size(); i++) {
+    if (i > 0) response.print(",");
+    response.print(beatTimes.at(i));
+  }
+  response.print("]}");
+  response.end();
 }
 
 // Non-blocking measurement processing - to be called in loop()
 void processRealtimeMeasurement() {
   if (!measurementActive) return;
   
-  // Read from sensor
-  long irValue = particleSensor.getIR();
-  long redValue = particleSensor.getRed();
+  // Drain everything the sensor FIFO collected since the last pass, so a slow
+  // network handler delays samples instead of dropping or duplicating them
+  if (sampleDataReady()) {
+    sensorFifo.read();
+    
+    // Samples the FIFO overwrote came before the ones still queued; skip their indices
+    droppedSamples += sensorFifo.overflowedSamples();
+    sampleIndex += sensorFifo.overflowedSamples();
+    for (uint16_t i = 0; i < sensorFifo.overflowedSamples(); i++) {
+      waveform.push(WaveformSample{0, 0});
+    }
+    
+    uint32_t redSample, irSample;
+    while (measurementActive && sensorFifo.nextSample(redSample, irSample)) {
+      waveform.push(WaveformSample{irSample, redSample});
+      streamSample(sampleIndex, irSample, redSample);
+      processSample(irSample, redSample, sampleTimeMs(sampleIndex));
+      sampleIndex++;
+    }
+  }
+  
+  if (!measurementActive) return;
+  
+  // A slice of the spectral heart rate analysis, bounded per tick
+  if (SensorConfig::spectralHr) {
+    spectralHr.step(SensorConfig::spectralSamplesPerTick);
+  }
+  
+  // Check if measurement duration has elapsed or the estimate has converged
+  // (continuous mode runs until stopped)
+  if (!continuousMode && (millis() - measurementStartTime >= SensorConfig::measurementDuration ||
+                          estimateConverged())) {
+    finishMeasurement();
+    serverBusy = false;
+  }
+}
+
+// Record an accepted beat; currentTime is the sample time now, up to one quality window later
+void recordBeat(const HeldBeat& beat, unsigned long currentTime) {
+  if (beat.spo2 > 0) {
+    ppg.addSpo2(beat.spo2); // SpO2 only from beats that pass, so poor stretches never reach it
+    displayedSpO2 = ppg.spo2();
+  }
+  if (!continuousMode && beatCount >= SensorConfig::maxBeats) return;
+  
+  bool intervalCounted = beatCount >= 1 && !beatSequenceBroken;
+  beatSequenceBroken = false;
+  beatTimes.push(beat.timeMs);
+  beatRecords.push(BeatRecord{(uint8_t)displayedSpO2, intervalCounted});
+  if (displayedSpO2 > 0) {
+    windowSpO2Sum += displayedSpO2;
+    windowSpO2Count++;
+  }
+  if (beat.spo2 > 0) {
+    spo2Stats.add(beat.spo2); // Per-beat spread; the smoothed, rounded reading barely moves
+  }
+  beatCount++;
+  
+  // System time of the beat
+  lastBeatSystemTime = millis() - (currentTime - beat.timeMs);
+  
+  Serial.println("❤️ Beat detected!");
+  Serial.print("Beat system time: ");
+  Serial.println(lastBeatSystemTime);
+  
+  // Calculate instantaneous BPM if we have at least 2 beats in a row
+  if (intervalCounted) {
+    long delta = beatTimes.at(beatTimes.size() - 1) - beatTimes.at(beatTimes.size() - 2);
+    beatIntervals.add(delta);
+    displayedBPM = 60000 / delta;
+    
+    // Sanity check
+    if (displayedBPM < SensorConfig::minValidBpm || displayedBPM > SensorConfig::maxValidBpm) {
+      displayedBPM = 0; // Invalid reading
+      hrv.skip();
+    } else {
+      hrv.add(delta);
+      Serial.print("Current BPM: ");
+      Serial.println(displayedBPM);
+    }
+  }
+  
+  // Broadcast beat event via WebSocket
+  JsonWriter json = newEvent("beat_detected");
+  json.fieldAsString("beat_time", lastBeatSystemTime);
+  json.field("beat_count", beatCount);
+  json.field("current_bpm", displayedBPM);
+  json.field("confidence", beat.confidence);
+  
+  broadcastMessage(json, SUBSCRIBE_BEATS);
+  streamBeat(beat.sample, beatCount, displayedBPM);
+}
+
+// Beats held since the last quality window, now that it has been scored. A
+// beat that isn't recorded breaks the sequence: the interval up to the next
+// recorded beat would span it, so that one isn't counted.
+void releaseHeldBeats(bool usable, unsigned long currentTime) {
+  for (uint16_t i = 0; i < heldBeats.size(); i++) {
+    const HeldBeat& beat = heldBeats.at(i);
+    if (beat.candidate && usable) {
+      recordBeat(beat, currentTime);
+    } else {
+      if (beat.candidate) rejectedBeats++;
+      beatSequenceBroken = true;
+      hrv.skip();
+    }
+  }
+  heldBeats.reset();
+}
+
+// Process one FIFO sample; currentTime is the sample time in ms since the measurement started
+void processSample(long irValue, long redValue, unsigned long currentTime) {
   static unsigned long fingerMissingStartTime = 0;
   
+  lastIrValue = irValue;
+  lastRedValue = redValue;
+  
+  // Auto gain: write new LED settings, then rebase the DSP once samples taken with them arrive. Runs
+  // ahead of the finger check so a weak finger can still be brought up to level
+  if (SensorConfig::ledAgc) {
+    AgcAction action = ledGain.update(irValue, redValue, sensorFifo.available() + SensorConfig::agcSettleSamples);
+    if (action == AGC_APPLY) {
+      applyLedSettings();
+    } else if (action == AGC_REBASE) {
+      ppg.rebase();
+    }
+  }
+  
   // Check if finger is placed on sensor
-  if (irValue < FINGER_PRESENCE_THRESHOLD) {
+  if (irValue < SensorConfig::fingerPresenceThreshold) {
     // Finger is missing - start or update the missing finger timer
     if (fingerMissingStartTime == 0) {
       fingerMissingStartTime = millis();
@@ -412,14 +1282,12 @@ void processRealtimeMeasurement() {
       Serial.println("No finger detected for 2 seconds. Measurement canceled.");
       
       // Notify WebSocket clients about finger removal
-      DynamicJsonDocument fingerDoc(256);
-      fingerDoc["event"] = "finger_removed";
-      fingerDoc["message"] = "Finger removed from sensor. Measurement canceled.";
-      fingerDoc["timestamp"] = getISOTimestamp();
+      JsonWriter json = newEvent("finger_removed");
+      json.field("message", "Finger removed from sensor. Measurement canceled.");
+      json.fieldAsString("timestamp", millis());
       
-      String fingerResponse;
-      serializeJson(fingerDoc, fingerResponse);
-      webSocket.broadcastTXT(fingerResponse);
+      broadcastMessage(json, SUBSCRIBE_STATUS);
+      streamFingerRemoved();
       
       // Reset measurement and clear the busy flag
       resetMeasurement();
@@ -435,151 +1303,50 @@ void processRealtimeMeasurement() {
     }
   }
   
-  // Skip processing if finger is not present
-  if (irValue < FINGER_PRESENCE_THRESHOLD) {
-    // Still broadcast sensor data to update UI but don't process beats
-    broadcastSensorData();
+  // Skip processing if finger is not present (the periodic broadcast keeps the UI updated)
+  if (irValue < SensorConfig::fingerPresenceThreshold) {
     return;
   }
   
-  // Update buffer
-  irBuffer[bufferIndex] = irValue;
-  bufferIndex = (bufferIndex + 1) % BUFFER_SIZE;
-  
-  // Calculate DC component (baseline) - moving average
-  irDC = 0;
-  for (int i = 0; i < BUFFER_SIZE; i++) {
-    irDC += irBuffer[i];
-  }
-  irDC /= BUFFER_SIZE;
-  
-  // Extract AC component (pulsatile)
-  long irAC = irValue - irDC;
-  
-  // Beat detection using slope detection
-  unsigned long currentTime = millis();
-  boolean validBeatTiming = (currentTime - lastBeatTime) > MIN_BEAT_INTERVAL;
-  
-  // Rising slope detection
-  if (irAC > irACPrev && !risingSlope) {
-    risingSlope = true;
-  }
-  // Peak detection (transition from rising to falling)
-  else if (irAC < irACPrev && risingSlope && validBeatTiming && irAC > 50) {
-    risingSlope = false;
-    lastBeatTime = currentTime;
-    
-    // Record beat
-    if (beatCount < MAX_BEATS) {
-      beatTimes[beatCount] = currentTime;
-      beatCount++;
-      
-      // Record system time of the beat
-      lastBeatSystemTime = getISOTimestamp();
-      
-      Serial.println("❤️ Beat detected!");
-      Serial.print("Beat system time: ");
-      Serial.println(lastBeatSystemTime);
-      
-      // Calculate instantaneous BPM if we have at least 2 beats
-      if (beatCount >= 2) {
-        long delta = beatTimes[beatCount-1] - beatTimes[beatCount-2];
-        displayedBPM = 60000 / delta;
-        
-        // Sanity check
-        if (displayedBPM < MIN_VALID_BPM || displayedBPM > MAX_VALID_BPM) {
-          displayedBPM = 0; // Invalid reading
-        } else {
-          Serial.print("Current BPM: ");
-          Serial.println(displayedBPM);
-        }
+  // Baseline removal, band-pass, beat detection and SpO2 (constant cost per sample)
+  if (ppg.update(irValue, redValue, currentTime)) {
+    HeldBeat beat = {currentTime, sampleIndex, 0, ppg.beatConfidence(), false};
+    if (!ledGain.settling()) {  // Else new LED settings are on their way in and the peak may be the level step
+      // Shape is judged now, against the last kept beat; the rest waits for the quality window
+      beat.candidate = signalQuality.beat() >= SensorConfig::minBeatCorrelation;
+      signalQuality.keepBeat(beat.candidate);
+      if (beat.candidate) {
+        beat.spo2 = ppg.measureSpo2();
+      } else {
+        rejectedBeats++;
       }
-      
-      // Broadcast beat event via WebSocket
-      DynamicJsonDocument beatDoc(256);
-      beatDoc["event"] = "beat_detected";
-      beatDoc["beat_time"] = lastBeatSystemTime;
-      beatDoc["beat_count"] = beatCount;
-      beatDoc["current_bpm"] = displayedBPM;
-      
-      String beatResponse;
-      serializeJson(beatDoc, beatResponse);
-      webSocket.broadcastTXT(beatResponse);
     }
+    heldBeats.push(beat);
+  }
+  if (SensorConfig::spectralHr) {
+    spectralHr.push(ppg.ac());
   }
   
-  // Store current AC value for next comparison
-  irACPrev = irAC;
-  
-  // Calculate SpO2 (improved algorithm with rolling average)
-  if (irValue > FINGER_PRESENCE_THRESHOLD && redValue > FINGER_PRESENCE_THRESHOLD) {
-    // Create rolling arrays for red and IR values
-    static long redValues[10] = {0};
-    static long irValues[10] = {0};
-    static int valueIndex = 0;
-    static bool arrayFilled = false;
-    
-    // Update arrays
-    redValues[valueIndex] = redValue;
-    irValues[valueIndex] = irValue;
-    valueIndex = (valueIndex + 1) % 10;
-    
-    // Check if we've filled the array at least once
-    if (valueIndex == 0) {
-      arrayFilled = true;
-    }
-    
-    // Only calculate SpO2 once we have enough data
-    if (arrayFilled) {
-      // Calculate min and max for both red and IR to find AC component
-      long redMax = redValues[0], redMin = redValues[0];
-      long irMax = irValues[0], irMin = irValues[0];
-      
-      for (int i = 1; i < 10; i++) {
-        if (redValues[i] > redMax) redMax = redValues[i];
-        if (redValues[i] < redMin) redMin = redValues[i];
-        if (irValues[i] > irMax) irMax = irValues[i];
-        if (irValues[i] < irMin) irMin = irValues[i];
-      }
-      
-      // Calculate R (ratio of ratios)
-      float redAC = (float)(redMax - redMin);
-      float redDC = (float)redMin;
-      float irAC = (float)(irMax - irMin);
-      float irDC = (float)irMin;
-      
-      // Avoid division by zero
-      if (irAC > 0 && redDC > 0 && irDC > 0) {
-        float R = (redAC / redDC) / (irAC / irDC);
-        
-        // Improved empirical formula for SpO2 calculation
-        float newSpO2 = 110.0 - 25.0 * R;
-        
-        // Apply a weighted moving average to smooth the readings (30% new, 70% old)
-        if (displayedSpO2 > 0) {
-          newSpO2 = 0.3 * newSpO2 + 0.7 * displayedSpO2;
-        }
-        
-        // Clamp to reasonable range
-        if (newSpO2 > 100) newSpO2 = 100;
-        if (newSpO2 < 80) newSpO2 = 80;
-        
-        displayedSpO2 = round(newSpO2);
-      }
-    }
+  // Score the signal; beats in windows that fail don't feed BPM or SpO2
+  if (signalQuality.update(ppg.dc(), ppg.unfilteredAc(), ppg.ac())) {
+    streamQuality();
+    releaseHeldBeats(signalQuality.usable(), currentTime);
   }
   
-  // Check if measurement duration has elapsed
-  if (currentTime - measurementStartTime >= MEASUREMENT_DURATION) {
-    finishMeasurement();
-    serverBusy = false;
+  if (continuousMode) {
+    slideBeatWindow(currentTime);
+    if (currentTime - lastWindowReport >= SensorConfig::continuousReportMs) {
+      lastWindowReport = currentTime;
+      reportWindow(currentTime);
+    }
+    return;
   }
   
-  // Show progress during measurement every 5 seconds
-  if (currentTime % 5000 < 10) {
-    unsigned long elapsedTime = currentTime - measurementStartTime;
-    int progressPercent = (elapsedTime * 100) / MEASUREMENT_DURATION;
-    int secondsRemaining = (MEASUREMENT_DURATION - elapsedTime) / 1000;
+  // Show progress during measurement every 5 seconds of samples
+  if (currentTime % 5000 < 1000 / SensorConfig::fifoSampleRate) {
+    unsigned long elapsedTime = currentTime;
+    int progressPercent = (elapsedTime * 100) / SensorConfig::measurementDuration;
+    int secondsRemaining = (SensorConfig::measurementDuration - elapsedTime) / 1000;
     
     Serial.print("Progress: ");
     Serial.print(progressPercent);
@@ -595,7 +1362,7 @@ void processRealtimeMeasurement() {
 }
 
 void setup() {
-  Serial.begin(115200);
+  Serial.begin(SensorConfig::serialBaud);
   Serial.println("\nMAX30105 Heart Rate Monitor for ESP8266");
   
   // Connect to WiFi
@@ -612,7 +1379,7 @@ void setup() {
   Serial.println(WiFi.localIP());
   
   // Initialize sensor
-  if (!particleSensor.begin(Wire, I2C_SPEED_STANDARD)) {
+  if (!particleSensor.begin(Wire, SensorConfig::i2cClockHz)) {
     Serial.println("MAX30105 was not found. Please check wiring/power.");
     while (1);
   }
@@ -620,57 +1387,82 @@ void setup() {
   Serial.println("Sensor initialized! Place your finger on the sensor.");
   
   // Configure sensor using values from config.h
-  byte ledBrightness = LED_BRIGHTNESS;
-  byte sampleAverage = SAMPLE_AVERAGE;
-  byte ledMode = LED_MODE;
-  int sampleRate = SAMPLE_RATE;
-  int pulseWidth = PULSE_WIDTH;
-  int adcRange = ADC_RANGE;
+  byte ledBrightness = SensorConfig::ledBrightness;
+  byte sampleAverage = SensorConfig::sampleAverage;
+  byte ledMode = SensorConfig::ledMode;
+  int sampleRate = SensorConfig::sampleRate;
+  int pulseWidth = SensorConfig::pulseWidth;
+  int adcRange = SensorConfig::adcRange;
   
   particleSensor.setup(ledBrightness, sampleAverage, ledMode, sampleRate, pulseWidth, adcRange);
-  particleSensor.setPulseAmplitudeRed(0xFF); // Maximum LED power
-  particleSensor.setPulseAmplitudeIR(0xFF);  // Maximum LED power
+  applyLedSettings(); // Starts at ledBrightness; auto gain tunes it per measurement
   
-  // Initialize buffer
-  for (int i = 0; i < BUFFER_SIZE; i++) {
-    irBuffer[i] = 0;
+  if (SensorConfig::sensorIntEnabled) {
+    // Raise INT once the FIFO has only sensorIntFifoSpace free slots left
+    particleSensor.setFIFOAlmostFull(SensorConfig::sensorIntFifoSpace);
+    particleSensor.enableAFULL();
+    pinMode(SensorConfig::sensorIntPin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(SensorConfig::sensorIntPin), onSensorInterrupt, FALLING);
+    Serial.println("Sensor interrupt enabled on GPIO " + String(SensorConfig::sensorIntPin));
   }
   
   // Setup server endpoints
   server.on("/health", HTTP_GET, handleHealth);
   server.on("/beat", HTTP_GET, handleBeat);
   server.on("/readings", HTTP_GET, handleReadings);
+  server.on("/stop", HTTP_GET, handleStop);
   server.on("/results", HTTP_GET, handleReadingResults); // New endpoint for results
   server.on("/clear_results", HTTP_GET, clearMeasurementResults); // New endpoint to clear results
+  server.on("/waveform", HTTP_GET, handleWaveform);
+  server.on("/events", HTTP_GET, handleEvents);
   
   // Start server
   server.begin();
-  Serial.println("HTTP server started on port " + String(SERVER_PORT));
+  Serial.println("HTTP server started on port " + String(SensorConfig::serverPort));
   
   // Start WebSocket server
   webSocket.begin();
   webSocket.onEvent(webSocketEvent);
-  Serial.println("WebSocket server started on port 81");
+  Serial.println("WebSocket server started on port " + String(SensorConfig::websocketPort));
+  
+  // Start the sampling tick last so setup time doesn't count as a missed deadline
+  sampleTick.begin(micros());
 }
 
 void loop() {
-  // Handle client requests and WebSocket events first to ensure responsiveness
-  webSocket.loop();
-  server.handleClient();
-  
-  // Only process measurements if explicitly started (not auto-started)
-  if (measurementActive) {
-    processRealtimeMeasurement();
+  // Acquisition and DSP run on the fixed sample tick, ahead of any network work
+  if (sampleTick.due(micros())) {
+    // Measurement work must not touch the heap; /health reports anything counted here
+    HeapAllocScope steadyState;
+    
+    // Only process measurements if explicitly started (not auto-started)
+    if (measurementActive) {
+      processRealtimeMeasurement();
+    }
+    flushStaleStreamFrame();
   }
   
-  // Only broadcast data periodically if there's an active measurement or if it's complete
-  unsigned long currentTime = millis();
-  if ((measurementActive || measurementComplete) && 
-      (currentTime - lastBroadcastTime >= BROADCAST_INTERVAL)) {
-    broadcastSensorData();
-    lastBroadcastTime = currentTime;
+  // Handle client requests and WebSocket events in the time left before the next tick
+  if (sampleTick.remainingUs(micros()) >= SensorConfig::networkSlackUs) {
+    webSocket.loop();
+    server.handleClient();
+    keepServerEventsAlive();
+    
+    // Only broadcast data periodically if there's an active measurement or if it's complete
+    unsigned long currentTime = millis();
+    if ((measurementActive || measurementComplete) && 
+        (currentTime - lastBroadcastTime >= SensorConfig::broadcastInterval)) {
+      HeapAllocScope steadyState;
+      broadcastSensorData();
+      lastBroadcastTime = currentTime;
+    }
   }
   
-  // Short delay to prevent CPU hogging
-  delay(10);
+  // Sleep until the next tick (delay() also lets the WiFi stack run)
+  unsigned long idleUs = sampleTick.remainingUs(micros());
+  if (idleUs >= 1000) {
+    delay(idleUs / 1000);
+  } else {
+    yield();
+  }
 }
\ No newline at end of file
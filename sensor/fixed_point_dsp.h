@@ -0,0 +1,64 @@
+// Integer replacements for the float SpO2/BPM math
+//
+// Neither the ATmega328 nor the ESP8266 has an FPU, so every float divide
+// is a few hundred cycles of software emulation. Values here are Qn fixed
+// point: an integer holding value * 2^n.
+
+#ifndef FIXED_POINT_DSP_H
+#define FIXED_POINT_DSP_H
+
+#include <stdint.h>
+
+#define SPO2_MIN_Q8 (80L << 8)
+#define SPO2_MAX_Q8 (100L << 8)
+
+// num / den with `shift` fractional bits. Both operands are scaled down
+// together until the shifted numerator fits in 32 bits; 0 when den is 0.
+inline uint32_t fixedDiv(uint32_t num, uint32_t den, uint8_t shift) {
+  while (num >= (1UL << (31 - shift))) {
+    num >>= 1;
+    den >>= 1;
+  }
+  return den ? (num << shift) / den : 0;
+}
+
+// R = (redAC / redDC) / (irAC / irDC) in Q8, evaluated as
+// (redAC / irAC) * (irDC / redDC) so both factors stay close to 1
+inline uint32_t ratioOfRatiosQ8(uint32_t redAC, uint32_t redDC, uint32_t irAC, uint32_t irDC) {
+  uint32_t acRatio = fixedDiv(redAC, irAC, 12);
+  uint32_t dcRatio = fixedDiv(irDC, redDC, 12);
+
+  // Q12 * Q12 = Q24; take the 16 bits back to Q8 off the larger factor
+  // first so the product always fits in 32 bits
+  uint8_t shift = 16;
+  while (shift > 0 && (acRatio > 0xFFFF || dcRatio > 0xFFFF)) {
+    if (acRatio > dcRatio) acRatio >>= 1;
+    else dcRatio >>= 1;
+    shift--;
+  }
+  if (acRatio > 0xFFFF || dcRatio > 0xFFFF) return 0xFFFF;  // R >= 256, far outside any valid SpO2
+  return (acRatio * dcRatio) >> shift;
+}
+
+inline int32_t clampSpo2Q8(int32_t spo2Q8) {
+  if (spo2Q8 > SPO2_MAX_Q8) return SPO2_MAX_Q8;
+  if (spo2Q8 < SPO2_MIN_Q8) return SPO2_MIN_Q8;
+  return spo2Q8;
+}
+
+// 30% new / 70% previous weighted average, Q8
+inline int32_t smoothSpo2Q8(int32_t newQ8, int32_t previousQ8) {
+  return (3 * newQ8 + 7 * previousQ8) / 10;
+}
+
+// Q8 to the nearest whole number
+inline int32_t roundQ8(int32_t valueQ8) {
+  return (valueQ8 + 128) >> 8;
+}
+
+// Heart rate in tenths of a BPM for `intervals` beat intervals spanning `spanMs`
+inline uint16_t bpmTenths(uint32_t intervals, uint32_t spanMs) {
+  return spanMs ? (uint16_t)((intervals * 600000UL + spanMs / 2) / spanMs) : 0;
+}
+
+#endif // FIXED_POINT_DSP_H
@@ -0,0 +1,52 @@
+// Heap allocation counter for the ESP8266 build
+//
+// Counts malloc/calloc/realloc calls made while a HeapAllocScope is open, so
+// the firmware can show the measurement loop never touches the heap. Needs
+// the allocator wrapped at link time (nodemcuv2 build_flags):
+//   -DTRACK_HEAP_ALLOCATIONS -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc
+// Without TRACK_HEAP_ALLOCATIONS the scope is empty and nothing is counted.
+
+#ifndef HEAP_ALLOC_COUNTER_H
+#define HEAP_ALLOC_COUNTER_H
+
+#include <Arduino.h>
+
+#ifdef TRACK_HEAP_ALLOCATIONS
+static const bool heapAllocationsTracked = true;
+#else
+static const bool heapAllocationsTracked = false;
+#endif
+
+volatile uint8_t heapAllocScopeDepth = 0;
+volatile unsigned long scopedHeapAllocations = 0;
+
+struct HeapAllocScope {
+  HeapAllocScope() { heapAllocScopeDepth++; }
+  ~HeapAllocScope() { heapAllocScopeDepth--; }
+};
+
+#ifdef TRACK_HEAP_ALLOCATIONS
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+// IRAM like the allocator itself, which may be called with the flash cache off
+void* IRAM_ATTR __wrap_malloc(size_t size) {
+  if (heapAllocScopeDepth) scopedHeapAllocations++;
+  return __real_malloc(size);
+}
+
+void* IRAM_ATTR __wrap_calloc(size_t count, size_t size) {
+  if (heapAllocScopeDepth) scopedHeapAllocations++;
+  return __real_calloc(count, size);
+}
+
+void* IRAM_ATTR __wrap_realloc(void* ptr, size_t size) {
+  if (heapAllocScopeDepth) scopedHeapAllocations++;
+  return __real_realloc(ptr, size);
+}
+}
+#endif
+
+#endif // HEAP_ALLOC_COUNTER_H
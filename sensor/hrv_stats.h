@@ -0,0 +1,55 @@
+// Heart rate variability over beat-to-beat (NN) intervals
+//
+// Time-domain HRV updated as each beat arrives, O(1) per beat with no
+// interval history: SDNN from a running variance, RMSSD and pNN50 from
+// running sums over successive differences.
+
+#ifndef HRV_STATS_H
+#define HRV_STATS_H
+
+#include <math.h>
+#include <stdint.h>
+#include "running_stats.h"
+
+class HrvStats {
+public:
+  HrvStats() { reset(); }
+
+  void reset() {
+    nn.reset();
+    previous = 0;
+    sumSquaredDiffs = 0;
+    diffs = 0;
+    over50 = 0;
+  }
+
+  // One valid beat interval in ms
+  void add(unsigned long intervalMs) {
+    nn.add(intervalMs);
+    if (previous > 0) {
+      long diff = (long)intervalMs - (long)previous;
+      sumSquaredDiffs += (uint64_t)(diff * diff);
+      diffs++;
+      if (diff > 50 || diff < -50) over50++;
+    }
+    previous = intervalMs;
+  }
+
+  // An interval was rejected (missed or extra beat): don't take a
+  // successive difference across it
+  void skip() { previous = 0; }
+
+  const RunningStats& intervals() const { return nn; }
+  float sdnn() const { return nn.stddev(); }  // ms
+  float rmssd() const { return diffs ? sqrtf((float)sumSquaredDiffs / diffs) : 0; }  // ms
+  float pnn50() const { return diffs ? 100.0f * over50 / diffs : 0; }  // % of successive differences over 50 ms
+
+private:
+  RunningStats nn;
+  unsigned long previous;  // 0 when the last interval was rejected
+  uint64_t sumSquaredDiffs;
+  uint32_t diffs;  // Wide enough for days of continuous monitoring
+  uint32_t over50;
+};
+
+#endif // HRV_STATS_H
@@ -0,0 +1,84 @@
+// Running statistics over beat-to-beat intervals
+//
+// Intervals go into a histogram with one bin per sample period, so adding
+// or removing one is O(1) and the median is one pass over the bins (no sort, no copy of
+// the interval list). Beat times are whole samples, so with BIN_MS equal
+// to the sample period the median is exact inside [MIN_MS, MAX_MS).
+
+#ifndef INTERVAL_STATS_H
+#define INTERVAL_STATS_H
+
+#include <stdint.h>
+
+template <uint16_t MIN_MS, uint16_t MAX_MS, uint8_t BIN_MS>
+class IntervalHistogram {
+public:
+  IntervalHistogram() { reset(); }
+
+  void reset() {
+    for (uint16_t i = 0; i < BINS; i++) bins[i] = 0;
+    total = 0;
+    sumMs = 0;
+  }
+
+  void add(unsigned long intervalMs) {
+    bins[binFor(intervalMs)]++;
+    total++;
+    sumMs += intervalMs;
+  }
+
+  // Take back an interval added earlier, e.g. when it leaves a sliding window
+  void remove(unsigned long intervalMs) {
+    uint16_t bin = binFor(intervalMs);
+    if (bins[bin] == 0) return;
+    bins[bin]--;
+    total--;
+    sumMs -= intervalMs;
+  }
+
+  uint16_t count() const { return total; }
+  unsigned long mean() const { return total ? sumMs / total : 0; }
+
+  // Median interval in ms, 0 when empty. Out-of-range intervals are kept in
+  // edge bins that report MIN_MS - BIN_MS and MAX_MS, so a median that lands
+  // there still reads as out of range to the caller.
+  unsigned long median() const {
+    if (total == 0) return 0;
+    if (total % 2 == 1) return kth(total / 2);
+    return (kth(total / 2 - 1) + kth(total / 2)) / 2;
+  }
+
+  // k-th smallest interval (0-based)
+  unsigned long kth(uint16_t k) const {
+    uint16_t seen = 0;
+    for (uint16_t i = 0; i < BINS; i++) {
+      seen += bins[i];
+      if (seen > k) return binValue(i);
+    }
+    return binValue(BINS - 1);
+  }
+
+private:
+  static_assert(MAX_MS > MIN_MS && BIN_MS > 0, "Invalid interval range");
+  static const uint16_t RANGE_BINS = (MAX_MS - MIN_MS + BIN_MS - 1) / BIN_MS;
+  static const uint16_t BINS = RANGE_BINS + 2;  // Plus under- and overflow bins
+
+  static uint16_t binFor(unsigned long intervalMs) {
+    if (intervalMs < MIN_MS) return 0;
+    if (intervalMs >= MAX_MS) return BINS - 1;
+    return 1 + (intervalMs - MIN_MS) / BIN_MS;
+  }
+
+  // Lower edge of the bin, which is the exact interval for sample-aligned input
+  static unsigned long binValue(uint16_t bin) {
+    if (bin == 0) return MIN_MS - BIN_MS;
+    if (bin == BINS - 1) return MAX_MS;
+    return MIN_MS + (unsigned long)(bin - 1) * BIN_MS;
+  }
+
+  uint16_t bins[BINS];
+  uint16_t total;
+  unsigned long sumMs;
+};
+
+#endif // INTERVAL_STATS_H
@@ -0,0 +1,149 @@
+// Automatic gain control for the MAX3010x LEDs and ADC range
+//
+// During a warm-up at the start of a measurement, the mean IR and Red
+// levels of each block of samples are compared with a target fraction of
+// ADC full scale, and the LED amplitudes are scaled towards it. DC level is
+// proportional to LED current, so one step usually lands within tolerance.
+// When the IR LED is already at maximum (or minimum) the ADC range is
+// stepped instead. Samples still queued when the change is written (the
+// rest of the FIFO burst, and any the sensor took meanwhile) use the old
+// settings, so the DSP is told to rebase on the first sample after them;
+// until then the caller should not trust beats. Settings found in one
+// measurement are the start of the next.
+
+#ifndef LED_AGC_H
+#define LED_AGC_H
+
+#include <stdint.h>
+
+enum AgcAction {
+  AGC_NONE,
+  AGC_APPLY,   // Write irAmplitude(), redAmplitude() and adcRangeBits() to the sensor
+  AGC_REBASE   // This sample is the first with the new settings; rebase the DSP before it
+};
+
+class LedAutoGain {
+public:
+  // fullScale in ADC counts; levels in percent of it; lengths in samples
+  LedAutoGain(uint32_t fullScale, uint8_t targetPercent, uint8_t tolerancePercent, uint8_t minAmplitude,
+              uint8_t initialAmplitude, uint16_t initialRangeNa, uint16_t blockSamples, uint16_t warmupSamples,
+              uint32_t presenceLevel)
+    : target(fullScale / 100 * targetPercent), tolerance(fullScale / 100 * tolerancePercent),
+      saturation(fullScale / 100 * 98), minAmp(minAmplitude), block(blockSamples), warmup(warmupSamples),
+      presence(presenceLevel),
+      irAmp(initialAmplitude), redAmp(initialAmplitude), rangeIndex(rangeIndexFor(initialRangeNa)) {
+    active = false;
+    countdown = 0;
+  }
+
+  // Begin a warm-up from the current settings
+  void start() {
+    active = true;
+    seen = 0;
+    countdown = 0;
+    startBlock();
+  }
+
+  // One sample; queued is how many samples taken with the current settings
+  // are still to come after it, should this one trigger a change
+  AgcAction update(uint32_t ir, uint32_t red, uint8_t queued) {
+    if (!warmingUp()) return AGC_NONE;
+    seen++;
+
+    // A change in flight still gets its rebase after the warm-up
+    if (countdown > 0) {
+      if (--countdown > 0) return AGC_NONE;
+      startBlock();
+      return AGC_REBASE;
+    }
+    if (seen >= warmup) {
+      active = false;
+      return AGC_NONE;
+    }
+
+    irSum += ir;
+    redSum += red;
+    if (++count < block) return AGC_NONE;
+    uint32_t irLevel = irSum / count;
+    uint32_t redLevel = redSum / count;
+    startBlock();
+    if (irLevel < presence) return AGC_NONE;  // No finger to measure
+
+    uint8_t oldRange = rangeIndex;
+    bool changed = adjust(irAmp, irLevel, true);
+    if (rangeIndex == oldRange) changed |= adjust(redAmp, redLevel, false);  // Else Red is re-measured next block
+    if (!changed) return AGC_NONE;
+    countdown = queued + 1;
+    return AGC_APPLY;
+  }
+
+  bool warmingUp() const { return active || countdown > 0; }
+  bool settling() const { return countdown > 0; }  // Between AGC_APPLY and AGC_REBASE
+  uint8_t irAmplitude() const { return irAmp; }
+  uint8_t redAmplitude() const { return redAmp; }
+  uint16_t adcRangeNa() const { return 2048 << rangeIndex; }
+  uint8_t adcRangeBits() const { return rangeIndex << 5; }  // MAX30105_ADCRANGE_* value
+
+private:
+  static uint8_t rangeIndexFor(uint16_t rangeNa) {
+    uint8_t index = 0;
+    while (index < 3 && (2048U << index) < rangeNa) index++;
+    return index;
+  }
+
+  void startBlock() {
+    irSum = 0;
+    redSum = 0;
+    count = 0;
+  }
+
+  // Scale amp so level moves to the target; true if anything changed. The
+  // IR channel may also step the shared ADC range: a range half as wide
+  // doubles the counts for the same LED current.
+  bool adjust(uint8_t& amp, uint32_t level, bool mayChangeRange) {
+    uint32_t wanted;
+    if (level >= saturation) {
+      wanted = amp / 2;  // Clipped, so the level says nothing about the real DC
+    } else {
+      uint32_t low = target - tolerance, high = target + tolerance;
+      if (level >= low && level <= high) return false;
+      wanted = level > 0 ? (uint32_t)amp * target / level : 255;
+    }
+
+    if (mayChangeRange && wanted > 255 && amp == 255 && rangeIndex > 0) {
+      rangeIndex--;
+      return true;
+    }
+    if (mayChangeRange && wanted < minAmp && amp == minAmp && rangeIndex < 3) {
+      rangeIndex++;
+      return true;
+    }
+
+    if (wanted > 255) wanted = 255;
+    if (wanted < minAmp) wanted = minAmp;
+    if (wanted == amp) return false;
+    amp = wanted;
+    return true;
+  }
+
+  uint32_t target;
+  uint32_t tolerance;
+  uint32_t saturation;
+  uint8_t minAmp;
+  uint16_t block;
+  uint16_t warmup;
+  uint32_t presence;
+
+  uint8_t irAmp;
+  uint8_t redAmp;
+  uint8_t rangeIndex;  // 0..3 = 2048, 4096, 8192, 16384 nA
+
+  bool active;
+  uint16_t seen;
+  uint16_t countdown;
+  uint32_t irSum;
+  uint32_t redSum;
+  uint16_t count;
+};
+
+#endif // LED_AGC_H
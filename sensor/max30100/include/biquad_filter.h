@@ -0,0 +1,118 @@
+// Fixed-point biquad (second-order IIR) filters
+//
+// Coefficients come from the RBJ audio EQ cookbook formulas, evaluated by
+// constexpr functions so a filter designed from config constants costs no
+// trig at runtime. They are stored as Q24 integers and every section costs
+// five 32x32->64 bit multiplies per sample.
+
+#ifndef BIQUAD_FILTER_H
+#define BIQUAD_FILTER_H
+
+#include <stdint.h>
+
+#define BIQUAD_COEFF_SHIFT 24
+#define BIQUAD_SIGNAL_SHIFT 8
+
+// Q24 coefficients of y = b0 x + b1 x[-1] + b2 x[-2] - a1 y[-1] - a2 y[-2]
+struct BiquadCoefficients {
+  long b0, b1, b2, a1, a2;
+};
+
+// Compile-time trig (C++11 constexpr, no <cmath>)
+namespace biquad_design {
+
+constexpr double pi = 3.14159265358979323846;
+
+// Taylor series; the terms up to x^51 are plenty for |x| <= pi
+constexpr double sinSeries(double x2, double term, int k) {
+  return k > 25 ? term : term + sinSeries(x2, -term * x2 / ((2 * k) * (2 * k + 1)), k + 1);
+}
+constexpr double sine(double x) { return sinSeries(x * x, x, 1); }
+constexpr double cosine(double x) { return sine(pi / 2 - x); }  // For 0 <= x <= pi
+
+constexpr long q24(double x) {
+  return (long)(x * (1L << BIQUAD_COEFF_SHIFT) + (x < 0 ? -0.5 : 0.5));
+}
+
+// Normalised by a0 = 1 + alpha
+constexpr BiquadCoefficients normalise(double b0, double b1, double b2, double a1, double a2, double a0) {
+  return BiquadCoefficients{q24(b0 / a0), q24(b1 / a0), q24(b2 / a0), q24(a1 / a0), q24(a2 / a0)};
+}
+
+constexpr double omega(double cutoffHz, double sampleRate) { return 2 * pi * cutoffHz / sampleRate; }
+
+// alpha = sin(w0) / (2 Q) with Q = 1/sqrt(2) (Butterworth)
+constexpr double butterworthAlpha(double w0) { return sine(w0) * 0.70710678118654752; }
+
+constexpr BiquadCoefficients lowPass(double c, double alpha) {
+  return normalise((1 - c) / 2, 1 - c, (1 - c) / 2, -2 * c, 1 - alpha, 1 + alpha);
+}
+constexpr BiquadCoefficients highPass(double c, double alpha) {
+  return normalise((1 + c) / 2, -(1 + c), (1 + c) / 2, -2 * c, 1 - alpha, 1 + alpha);
+}
+
+}  // namespace biquad_design
+
+// Second-order Butterworth low-pass / high-pass at cutoffHz
+constexpr BiquadCoefficients lowPassBiquad(double cutoffHz, double sampleRate) {
+  return biquad_design::lowPass(biquad_design::cosine(biquad_design::omega(cutoffHz, sampleRate)),
+                                biquad_design::butterworthAlpha(biquad_design::omega(cutoffHz, sampleRate)));
+}
+constexpr BiquadCoefficients highPassBiquad(double cutoffHz, double sampleRate) {
+  return biquad_design::highPass(biquad_design::cosine(biquad_design::omega(cutoffHz, sampleRate)),
+                                 biquad_design::butterworthAlpha(biquad_design::omega(cutoffHz, sampleRate)));
+}
+
+// One section in direct form I. The signal carries BIQUAD_SIGNAL_SHIFT
+// fractional bits so poles close to the unit circle (low cutoffs) don't
+// round the output into a dead band.
+class Biquad {
+public:
+  explicit Biquad(const BiquadCoefficients& coefficients) : c(coefficients) { reset(); }
+
+  void reset() {
+    x1 = x2 = 0;
+    y1 = y2 = 0;
+  }
+
+  // x and the result are in the same fixed-point scale
+  long update(long x) {
+    int64_t acc = (int64_t)c.b0 * x + (int64_t)c.b1 * x1 + (int64_t)c.b2 * x2
+                - (int64_t)c.a1 * y1 - (int64_t)c.a2 * y2;
+    long y = (long)((acc + (1L << (BIQUAD_COEFF_SHIFT - 1))) >> BIQUAD_COEFF_SHIFT);
+    x2 = x1;
+    x1 = x;
+    y2 = y1;
+    y1 = y;
+    return y;
+  }
+
+private:
+  BiquadCoefficients c;
+  long x1, x2;
+  long y1, y2;
+};
+
+// Band-pass as a Butterworth high-pass at lowHz followed by a Butterworth
+// low-pass at highHz (4th order overall). Takes and returns plain samples.
+class BandPassFilter {
+public:
+  BandPassFilter(const BiquadCoefficients& highPass, const BiquadCoefficients& lowPass)
+    : highPassSection(highPass), lowPassSection(lowPass) {}
+
+  void reset() {
+    highPassSection.reset();
+    lowPassSection.reset();
+  }
+
+  long update(long sample) {
+    long y = lowPassSection.update(highPassSection.update(sample * (1L << BIQUAD_SIGNAL_SHIFT)));
+    return y / (1L << BIQUAD_SIGNAL_SHIFT);
+  }
+
+private:
+  Biquad highPassSection;
+  Biquad lowPassSection;
+};
+
+#endif // BIQUAD_FILTER_H
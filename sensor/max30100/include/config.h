@@ -1,36 +1,184 @@
 // ESP8266 Sensor Configuration File
+//
+// Everything except the WiFi credentials is a constexpr member of a
+// per-board struct, so array sizes and derived constants are computed at
+// compile time and checked with static_assert below. SensorConfig picks
+// the struct for the board being built (nodemcuv2 or nanoatmega328).
 
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <stdint.h>
 
-#define WIFI_SSID "Redmi 10C"      
-#define WIFI_PASSWORD "sandra123"  
 
+#define WIFI_SSID "Redmi 10C"
+#define WIFI_PASSWORD "sandra123"
 
-#define SERVER_PORT 80  
-#define WEBSOCKET_PORT 81  // Added WebSocket port
 
+// MAX3010x settings accepted by particleSensor.setup()
+constexpr bool validSampleRate(uint16_t rate) {
+  return rate == 50 || rate == 100 || rate == 200 || rate == 400 ||
+         rate == 800 || rate == 1000 || rate == 1600 || rate == 3200;
+}
+constexpr bool validSampleAverage(uint8_t average) {
+  return average == 1 || average == 2 || average == 4 ||
+         average == 8 || average == 16 || average == 32;
+}
+constexpr bool validPulseWidth(uint16_t width) {
+  return width == 69 || width == 118 || width == 215 || width == 411;
+}
+// ADC full scale in counts: 15 to 18 bits of resolution with the pulse width
+constexpr uint32_t adcFullScale(uint16_t width) {
+  return width >= 411 ? 262143UL : width >= 215 ? 131071UL : width >= 118 ? 65535UL : 32767UL;
+}
 
-#define LED_BRIGHTNESS 0xFF  
-#define SAMPLE_AVERAGE 8     
-#define LED_MODE 2           
-#define SAMPLE_RATE 100      
-#define PULSE_WIDTH 1600     
-#define ADC_RANGE 16384      
+// Sensor part on the board; picks the SpO2 calibration curve (spo2_calibration.h)
+enum SensorModel {
+  SENSOR_MAX30100,
+  SENSOR_MAX30105
+};
 
 
-#define MEASUREMENT_DURATION 60000  // 60 seconds of measurement
-#define MIN_BEAT_INTERVAL 250      
-#define MAX_BEATS 250              // Increased to accommodate 60 seconds of measurement
-#define BUFFER_SIZE 150            // Increased buffer size for better accuracy
+// ESP8266 (NodeMCU) heart rate server - esp8266_sensor.cpp
+struct NodeMcuConfig {
+  static constexpr uint16_t serverPort = 80;
+  static constexpr uint16_t websocketPort = 81;
+  static constexpr uint32_t serialBaud = 115200;
+  static constexpr uint32_t i2cClockHz = 400000;  // Fast mode; drop to 100000 (standard) for long sensor wires
 
+  static constexpr uint8_t ledBrightness = 0xFF;
+  static constexpr uint8_t sampleAverage = 4;
+  static constexpr uint8_t ledMode = 2;           // Red + IR
+  static constexpr uint16_t sampleRate = 400;
+  static constexpr uint16_t pulseWidth = 411;     // us, the widest the sensor supports
+  static constexpr uint16_t adcRange = 16384;
+  static constexpr SensorModel sensorModel = SENSOR_MAX30105;  // SpO2 calibration curve
+  static constexpr uint16_t fifoSampleRate = sampleRate / sampleAverage;  // Averaged samples/s in the FIFO (100 Hz)
+  static constexpr bool ledAgc = true;                    // Tune LED amplitude and ADC range at the start of each measurement
+  static constexpr uint8_t agcTargetPercent = 50;         // Aim the DC level at 50 % of ADC full scale...
+  static constexpr uint8_t agcTolerancePercent = 15;      // ...give or take 15 %
+  static constexpr uint8_t agcMinAmplitude = 0x10;        // Lowest LED amplitude (~3 mA)
+  static constexpr uint16_t agcBlockSamples = 25;         // Samples averaged per adjustment (250 ms)
+  static constexpr uint16_t agcWarmupSamples = 300;       // Adjust during the first 3 s only
+  static constexpr long agcMinLevel = 6000;               // Below this IR level there is no finger to tune for
+  static constexpr uint8_t agcSettleSamples = 2;          // Old-setting samples beyond the current FIFO burst (one being averaged, one taken meanwhile)
+  static constexpr uint32_t sampleTickUs = 1000000UL / fifoSampleRate;    // Acquisition/DSP tick (10 ms)
+  static constexpr uint32_t networkSlackUs = 2000;                        // Min time left in a tick to start network work
 
-#define FINGER_PRESENCE_THRESHOLD 25000  // Slightly lower threshold for better finger detection
-#define MIN_VALID_BPM 40                 
-#define MAX_VALID_BPM 220               
+  static constexpr bool sensorIntEnabled = false;     // Read the FIFO when the sensor INT pin fires instead of every tick
+  static constexpr uint8_t sensorIntPin = 14;         // GPIO wired to the sensor INT pin (D5 on NodeMCU, active low)
+  static constexpr uint8_t sensorIntFifoSpace = 15;   // Fire when 15 of 32 FIFO slots are free (17 samples queued)
+  static constexpr uint8_t sensorFifoDepth = 32;      // Samples the sensor FIFO holds before it overwrites the oldest
+  // Read the FIFO anyway if INT stays quiet this long: 3/4 of the time the FIFO takes to fill (240 ms),
+  // so a missed edge costs latency rather than samples
+  static constexpr uint16_t sensorIntTimeoutMs = (uint32_t)sensorFifoDepth * 1000 / fifoSampleRate * 3 / 4;
+  static_assert(sensorIntTimeoutMs < (uint32_t)sensorFifoDepth * 1000 / fifoSampleRate,
+                "The INT timeout must expire before the sensor FIFO overflows");
 
+  static constexpr uint32_t measurementDuration = 60000;  // 60 seconds of measurement
+  static constexpr uint16_t minBeatInterval = 250;
+  static constexpr uint16_t maxBeats = 250;               // Enough for 60 seconds at maxValidBpm
+  static constexpr uint16_t bufferSize = 150;             // Moving-average baseline window in samples
+  static constexpr bool baselineIir = false;              // Single-pole IIR baseline instead of the moving average
+  static constexpr uint8_t baselineIirShift = 7;          // IIR time constant of 2^7 samples (~1.3 s at 100 Hz)
+  static constexpr bool bandPass = true;                  // Band-pass the AC signal before beat detection
+  static constexpr float bandPassLowHz = 0.5f;            // 30 BPM
+  static constexpr float bandPassHighHz = 4.0f;           // 240 BPM; cuts noise that double-counts beats
+  static constexpr bool spectralHr = true;                // Cross-check the beat count with a spectral heart rate estimate
+  static constexpr uint8_t spectralDecimation = 4;        // Spectrum of the AC signal at 25 Hz (10 s window)
+  static constexpr uint8_t spectralSamplesPerTick = 32;   // Window samples analysed per tick (an analysis spans 8 ticks)
+  static constexpr uint8_t spectralMinPeakShare = 40;     // % of in-band power near the peak for the spectrum to be trusted
+  static constexpr uint8_t hrCrossCheckPercent = 10;      // Estimates further apart than this disagree
+  static constexpr long beatAcThreshold = 50;             // Floor of the adaptive beat threshold (AC amplitude)
+  static constexpr uint8_t beatThresholdPercent = 60;     // Beat threshold as a share of the recent beat height
+  static constexpr uint8_t beatEnvelopeShift = 7;         // Beat height envelope decays by 1/2^7 per sample (~1.3 s)
+  static constexpr uint8_t beatRefractoryPercent = 60;    // Ignore peaks sooner than 60% of the beat interval
+  static constexpr bool fixedPoint = true;                // Integer SpO2 math (no FPU on ESP8266); false = float reference
+  static constexpr uint16_t spo2Window = 150;             // SpO2 min/max window in samples (1.5 s), evaluated at each beat
+  static constexpr bool earlyStop = true;                 // Finish before measurementDuration once the estimate has converged
+  static constexpr uint32_t earlyStopMinMs = 15000;       // ...but not before 15 s
+  static constexpr uint8_t earlyStopMinBeats = 12;        // ...and 12 beats with a rate and SpO2
+  static constexpr float earlyStopBpmCi = 2.0f;           // 95% CI of the mean heart rate within +/-2 BPM
+  static constexpr float earlyStopSpo2Ci = 1.0f;          // 95% CI of the mean SpO2 within +/-1 %
+  static constexpr bool beatTemplate = true;              // Confirm peaks against a pulse template learned per measurement
+  static constexpr uint8_t templateSamples = 48;          // Template length up to the peak (0.48 s)
+  static constexpr uint8_t templateLearnBeats = 5;        // Beats averaged into the template...
+  static constexpr uint8_t templateMinConfidence = 70;    // ...each with at least this beat confidence
+  static constexpr int8_t templateMatch = 70;             // Correlation (%) that makes a peak under the threshold a beat
+  static constexpr int8_t templateMinMatch = 30;          // Correlation (%) a peak over the threshold still needs
+  static constexpr uint16_t qualityWindow = 200;          // Signal quality scored every 2 s of samples
+  static constexpr uint8_t beatShapeSamples = 48;         // Beat shape compared between beats (0.48 s up to the peak)
+  static constexpr uint16_t minPerfusion = 10;            // Perfusion index of a usable signal, in 0.01 %: 0.1 %...
+  static constexpr uint16_t maxPerfusion = 2000;          // ...to 20 %; above that the finger is moving
+  static constexpr uint8_t minSignalQuality = 50;         // Windows scoring lower are excluded from BPM and SpO2
+  static constexpr int8_t minBeatCorrelation = 50;        // Beats shaped less like the previous one (%) are rejected
+  static constexpr uint32_t continuousWindowMs = 30000;   // Continuous mode: estimate over the last 30 s of beats
+  static constexpr uint16_t continuousReportMs = 5000;    // ...sent every 5 s
+  static constexpr uint16_t waveformSamples = 1024;       // Raw samples kept for /waveform (~10 s, 8 KB of RAM)
 
-#define BROADCAST_INTERVAL 500  // Broadcast sensor data every 500ms
+  static constexpr long fingerPresenceThreshold = 25000;  // Slightly lower threshold for better finger detection
+  static constexpr uint16_t minValidBpm = 40;
+  static constexpr uint16_t maxValidBpm = 220;
 
-#endif // CONFIG_H
\ No newline at end of file
+  static constexpr uint16_t broadcastInterval = 500;      // Broadcast sensor data every 500ms
+  static constexpr uint8_t rawFrameSamples = 25;          // Max samples per binary stream frame (250 ms at 100 Hz)
+  static constexpr uint8_t batchEventBytes = 48;          // Room for event records in one stream frame
+  static constexpr uint16_t batchMaxAgeMs = 100;          // Send a stream frame at the latest this long after it was started
+  static constexpr uint16_t clientSendReserve = 256;      // Free TCP send buffer a client must keep, or droppable data is skipped
+  static constexpr uint8_t maxEventClients = 2;           // Concurrent /events (Server-Sent Events) streams
+  static constexpr uint16_t eventKeepAliveMs = 15000;     // Comment line on idle /events streams
+};
+
+
+// Arduino Nano bench sketch - arduino_test.cpp (2 KB of RAM)
+struct NanoConfig {
+  static constexpr uint32_t serialBaud = 9600;
+  static constexpr uint32_t i2cClockHz = 400000;
+
+  static constexpr uint8_t ledBrightness = 0xFF;  // Full brightness for better signal
+  static constexpr uint8_t sampleAverage = 8;     // Average 8 samples for better stability
+  static constexpr uint8_t ledMode = 2;           // Red + IR
+  static constexpr uint16_t sampleRate = 100;
+  static constexpr uint16_t pulseWidth = 411;     // Maximum pulse width for more light
+  static constexpr uint16_t adcRange = 16384;
+  static constexpr SensorModel sensorModel = SENSOR_MAX30105;  // SpO2 calibration curve
+
+  static constexpr uint32_t measurementDuration = 30000;  // 30 seconds
+  static constexpr uint16_t minBeatInterval = 250;        // 250ms (240 BPM max)
+  static constexpr uint16_t maxBeats = 120;
+  static constexpr uint16_t bufferSize = 100;
+  static constexpr long beatAcThreshold = 50;
+
+  static constexpr long fingerPresenceThreshold = 30000;  // Lower threshold for detection
+  static constexpr uint16_t minValidBpm = 40;
+  static constexpr uint16_t maxValidBpm = 220;
+
+  static constexpr bool debug = true;  // Print IR/DC/AC twice a second
+};
+
+
+#if defined(__AVR__)
+typedef NanoConfig SensorConfig;
+#else
+typedef NodeMcuConfig SensorConfig;
+#endif
+
+
+// Checks every board config has to pass; instantiated for SensorConfig only
+template <class Config>
+struct SensorConfigChecks {
+  static_assert(validSampleRate(Config::sampleRate), "sampleRate is not a MAX3010x sample rate");
+  static_assert(validSampleAverage(Config::sampleAverage), "sampleAverage must be 1, 2, 4, 8, 16 or 32");
+  static_assert(validPulseWidth(Config::pulseWidth), "pulseWidth must be 69, 118, 215 or 411 us");
+  static_assert(Config::pulseWidth < 411 || Config::sampleRate <= 400,
+                "A 411 us pulse width allows at most 400 samples/s with two LEDs");
+  static_assert(Config::minBeatInterval <= 60000UL / Config::maxValidBpm,
+                "minBeatInterval would reject beats below maxValidBpm");
+  static_assert(Config::maxBeats >= Config::measurementDuration * Config::maxValidBpm / 60000UL,
+                "maxBeats cannot hold a full measurement at maxValidBpm");
+  static_assert(Config::bufferSize <= 8192, "Running-sum baseline window too long for a long sum");
+  static const bool ok = true;
+};
+static_assert(SensorConfigChecks<SensorConfig>::ok, "Invalid sensor configuration");
+
+#endif // CONFIG_H
@@ -0,0 +1,49 @@
+// Fixed-size history that keeps the most recent N items
+//
+// push() overwrites the oldest item once the ring is full; items are read
+// back oldest first with at(0) .. at(size() - 1).
+
+#ifndef HISTORY_RING_H
+#define HISTORY_RING_H
+
+#include <stdint.h>
+
+template <typename T, uint16_t N>
+class HistoryRing {
+public:
+  HistoryRing() { reset(); }
+
+  void reset() {
+    next = 0;
+    count = 0;
+    pushes = 0;
+  }
+
+  void push(const T& item) {
+    items[next] = item;
+    next = (next + 1) % N;
+    if (count < N) count++;
+    pushes++;
+  }
+
+  // i = 0 is the oldest item still held
+  const T& at(uint16_t i) const {
+    uint16_t start = count < N ? 0 : next;
+    return items[(start + i) % N];
+  }
+
+  const T& newest() const { return at(count - 1); }
+  uint16_t size() const { return count; }
+  bool full() const { return count == N; }
+
+  // Items pushed since reset(), including the ones overwritten
+  unsigned long total() const { return pushes; }
+
+private:
+  T items[N];
+  uint16_t next;
+  uint16_t count;
+  unsigned long pushes;
+};
+
+#endif // HISTORY_RING_H
@@ -0,0 +1,147 @@
+// Minimal JSON object writer into a caller-supplied buffer
+//
+// Never allocates: integers are formatted by hand (no printf/String), and
+// output that does not fit is cut at the last whole field and flagged.
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class JsonWriter {
+public:
+  JsonWriter(char* buffer, size_t size) : out(buffer), capacity(size), used(0), fields(0), overflow(false) {
+    put('{');
+  }
+
+  JsonWriter& field(const char* key, const char* value) {
+    beginField(key);
+    putString(value);
+    return endField();
+  }
+  JsonWriter& field(const char* key, bool value) {
+    beginField(key);
+    putRaw(value ? "true" : "false");
+    return endField();
+  }
+  JsonWriter& field(const char* key, long value) {
+    beginField(key);
+    putInteger(value);
+    return endField();
+  }
+  JsonWriter& field(const char* key, int value) { return field(key, (long)value); }
+  JsonWriter& field(const char* key, unsigned int value) { return field(key, (unsigned long)value); }
+  JsonWriter& field(const char* key, unsigned long value) {
+    beginField(key);
+    putUnsigned(value);
+    return endField();
+  }
+
+  // Number written as a quoted string, e.g. the millis() timestamps
+  JsonWriter& fieldAsString(const char* key, unsigned long value) {
+    beginField(key);
+    put('"');
+    putUnsigned(value);
+    put('"');
+    return endField();
+  }
+
+  // Fixed-point value with one decimal: 725 -> 72.5, 970 -> 97
+  JsonWriter& fieldTenths(const char* key, long tenths) {
+    beginField(key);
+    if (tenths < 0) {
+      put('-');
+      tenths = -tenths;
+    }
+    putUnsigned(tenths / 10);
+    if (tenths % 10) {
+      put('.');
+      put('0' + tenths % 10);
+    }
+    return endField();
+  }
+
+  // Close the object; returns the NUL-terminated text
+  const char* finish() {
+    if (used < capacity) out[used] = '}';
+    used = used < capacity ? used + 1 : capacity;
+    terminate();
+    return out;
+  }
+
+  const char* c_str() const { return out; }
+  size_t length() const { return used; }
+  bool overflowed() const { return overflow; }
+
+private:
+  void beginField(const char* key) {
+    mark = used;
+    if (fields > 0) put(',');
+    putString(key);
+    put(':');
+  }
+
+  // Roll a field that did not fit back out, leaving room for the closing brace
+  JsonWriter& endField() {
+    if (used + 2 > capacity) {
+      used = mark;
+      overflow = true;
+    } else {
+      fields++;
+    }
+    terminate();
+    return *this;
+  }
+
+  void put(char c) {
+    if (used < capacity) out[used] = c;
+    used++;
+  }
+
+  void putRaw(const char* text) {
+    while (*text) put(*text++);
+  }
+
+  void putString(const char* text) {
+    put('"');
+    for (; *text; text++) {
+      if (*text == '"' || *text == '\\') put('\\');
+      put(*text);
+    }
+    put('"');
+  }
+
+  void putUnsigned(unsigned long value) {
+    char digits[10];
+    uint8_t count = 0;
+    do {
+      digits[count++] = '0' + value % 10;
+      value /= 10;
+    } while (value > 0);
+    while (count > 0) put(digits[--count]);
+  }
+
+  void putInteger(long value) {
+    if (value < 0) {
+      put('-');
+      putUnsigned(0UL - (unsigned long)value);
+    } else {
+      putUnsigned(value);
+    }
+  }
+
+  void terminate() {
+    if (capacity == 0) return;
+    out[used < capacity ? used : capacity - 1] = '\0';
+  }
+
+  char* out;
+  size_t capacity;
+  size_t used;
+  size_t mark;
+  uint16_t fields;
+  bool overflow;
+};
+
+#endif // JSON_WRITER_H
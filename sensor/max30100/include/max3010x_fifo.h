@@ -0,0 +1,111 @@
+// Burst reader for the MAX3010x sample FIFO
+//
+// One transaction fetches the write pointer, overflow counter and read
+// pointer; the queued samples then come out in as few FIFO_DATA reads as
+// the Wire buffer allows, instead of one getIR()/getRed() round trip each.
+
+#ifndef MAX3010X_FIFO_H
+#define MAX3010X_FIFO_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+#define MAX3010X_FIFO_DEPTH 32
+
+#ifdef BUFFER_LENGTH
+#define MAX3010X_WIRE_BUFFER BUFFER_LENGTH  // Wire receive buffer (128 on ESP8266, 32 on AVR)
+#else
+#define MAX3010X_WIRE_BUFFER 32
+#endif
+
+class Max3010xFifo {
+public:
+  // activeLeds is 2 for Red + IR (LED_MODE 2), each LED adds 3 bytes per sample
+  explicit Max3010xFifo(TwoWire& wirePort, uint8_t activeLeds = 2, uint8_t i2cAddress = 0x57)
+    : wire(wirePort), address(i2cAddress), bytesPerSample(activeLeds * 3),
+      count(0), position(0), lastOverflow(0), errors(0) {}
+
+  // Read every sample queued in the sensor FIFO. Returns the number read, 0 on a bus error.
+  uint8_t read() {
+    count = 0;
+    position = 0;
+    lastOverflow = 0;
+
+    uint8_t pointers[3];  // FIFO_WR_PTR, OVF_COUNTER, FIFO_RD_PTR
+    if (!readRegisters(REG_FIFO_WR_PTR, pointers, 3)) return 0;
+
+    uint8_t queued = (pointers[0] - pointers[2]) & (MAX3010X_FIFO_DEPTH - 1);
+    lastOverflow = pointers[1];
+    if (queued == 0 && lastOverflow > 0) {
+      queued = MAX3010X_FIFO_DEPTH;  // Equal pointers after an overflow mean a full FIFO
+    }
+
+    uint8_t perTransaction = MAX3010X_WIRE_BUFFER / bytesPerSample;
+    uint8_t raw[MAX3010X_WIRE_BUFFER];
+    while (count < queued) {
+      uint8_t batch = queued - count;
+      if (batch > perTransaction) batch = perTransaction;
+      if (!readRegisters(REG_FIFO_DATA, raw, batch * bytesPerSample)) break;
+
+      for (uint8_t i = 0; i < batch; i++) {
+        const uint8_t* sample = raw + i * bytesPerSample;
+        red[count] = unpack(sample);
+        ir[count] = bytesPerSample >= 6 ? unpack(sample + 3) : 0;
+        count++;
+      }
+    }
+    return count;
+  }
+
+  // Pop the next sample from the last read(); false when all have been consumed
+  bool nextSample(uint32_t& redValue, uint32_t& irValue) {
+    if (position >= count) return false;
+    redValue = red[position];
+    irValue = ir[position];
+    position++;
+    return true;
+  }
+
+  uint8_t available() const { return count - position; }
+  uint8_t overflowedSamples() const { return lastOverflow; }  // Lost before the last read()
+  unsigned long busErrors() const { return errors; }
+
+private:
+  static const uint8_t REG_FIFO_WR_PTR = 0x04;
+  static const uint8_t REG_FIFO_DATA = 0x07;
+
+  // 18-bit sample, MSB first
+  static uint32_t unpack(const uint8_t* bytes) {
+    return (((uint32_t)bytes[0] << 16) | ((uint32_t)bytes[1] << 8) | bytes[2]) & 0x3FFFF;
+  }
+
+  bool readRegisters(uint8_t reg, uint8_t* out, uint8_t length) {
+    wire.beginTransmission(address);
+    wire.write(reg);
+    if (wire.endTransmission(false) != 0) {
+      errors++;
+      return false;
+    }
+    if (wire.requestFrom(address, length) != length) {
+      errors++;
+      while (wire.available()) wire.read();
+      return false;
+    }
+    for (uint8_t i = 0; i < length; i++) {
+      out[i] = wire.read();
+    }
+    return true;
+  }
+
+  TwoWire& wire;
+  uint8_t address;
+  uint8_t bytesPerSample;
+  uint32_t red[MAX3010X_FIFO_DEPTH];
+  uint32_t ir[MAX3010X_FIFO_DEPTH];
+  uint8_t count;
+  uint8_t position;
+  uint8_t lastOverflow;
+  unsigned long errors;
+};
+
+#endif // MAX3010X_FIFO_H
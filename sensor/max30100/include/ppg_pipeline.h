@@ -0,0 +1,191 @@
+// Per-sample PPG processing, parameterized on a board config
+//
+// Baseline removal, band-pass filtering, beat detection and SpO2 for one IR/Red sample. Window
+// lengths and estimator types come from the Config struct (see config.h),
+// so every buffer is sized at compile time for the board being built.
+
+#ifndef PPG_PIPELINE_H
+#define PPG_PIPELINE_H
+
+#include <stdint.h>
+#include <math.h>
+#include "baseline_estimator.h"
+#include "beat_template.h"
+#include "biquad_filter.h"
+#include "peak_detector.h"
+#include "sliding_extrema.h"
+#include "fixed_point_dsp.h"
+#include "spo2_calibration.h"
+
+// Compile-time type choice (AVR has no <type_traits>)
+template <bool Condition, class IfTrue, class IfFalse>
+struct SelectType {
+  typedef IfTrue type;
+};
+template <class IfTrue, class IfFalse>
+struct SelectType<false, IfTrue, IfFalse> {
+  typedef IfFalse type;
+};
+
+template <class Config>
+class PpgPipeline {
+public:
+  typedef typename SelectType<Config::baselineIir,
+                              IirBaseline<Config::baselineIirShift>,
+                              MovingAverageBaseline<Config::bufferSize> >::type Baseline;
+
+  PpgPipeline()
+    : bandPass(highPassBiquad(Config::bandPassLowHz, Config::fifoSampleRate),
+               lowPassBiquad(Config::bandPassHighHz, Config::fifoSampleRate)),
+      beatDetector(Config::beatAcThreshold, Config::minBeatInterval, 60000UL / Config::minValidBpm,
+                   Config::beatThresholdPercent, Config::beatRefractoryPercent, Config::beatEnvelopeShift),
+      beatTemplate(Config::templateLearnBeats) {
+    reset();
+  }
+
+  void reset() {
+    baseline.reset();
+    bandPass.reset();
+    beatDetector.reset();
+    beatTemplate.reset();
+    redWindow.reset();
+    irWindow.reset();
+    dcValue = 0;
+    acValue = 0;
+    unfilteredAcValue = 0;
+    spo2Value = 0;
+    beatSpo2Value = 0;
+  }
+
+  // Process one sample taken timeMs into the measurement; true when it completes a beat
+  bool update(long irValue, long redValue, unsigned long timeMs) {
+    // DC component (baseline) and pulsatile AC component
+    dcValue = baseline.update(irValue);
+    acValue = irValue - dcValue;
+    unfilteredAcValue = acValue;
+    if (Config::bandPass) {
+      acValue = bandPass.update(acValue);  // Drop residual drift and high-frequency noise
+    }
+
+    bool beat;
+    if (Config::beatTemplate) {
+      // Once learned, the template confirms peaks: weak ones that match are
+      // beats, strong ones that don't (dicrotic notch, motion) are not
+      beatTemplate.push(acValue);
+      beat = beatDetector.update(acValue, timeMs, TemplateMatch{beatTemplate});
+      if (beat && beatDetector.confidence() >= Config::templateMinConfidence) {
+        beatTemplate.learn();
+      }
+    } else {
+      beat = beatDetector.update(acValue, timeMs);
+    }
+
+    if (irValue > Config::fingerPresenceThreshold && redValue > Config::fingerPresenceThreshold) {
+      redWindow.push(redValue);
+      irWindow.push(irValue);
+    }
+    return beat;
+  }
+
+  // SpO2 at a beat: ratio of ratios over the min/max window (kept O(1) per
+  // sample by update()) turned into SpO2 through the sensor's calibration
+  // curve. Unsmoothed; 0 until the window spans a full pulse.
+  float measureSpo2() {
+    beatSpo2Value = 0;
+    if (!irWindow.full()) return 0;
+
+    long redMax = redWindow.max(), redMin = redWindow.min();
+    long irMax = irWindow.max(), irMin = irWindow.min();
+    if (irMax <= irMin || redMin <= 0 || irMin <= 0) return 0;  // Avoid division by zero
+
+    if (Config::fixedPoint) {
+      uint32_t ratioQ8 = ratioOfRatiosQ8(redMax - redMin, redMin, irMax - irMin, irMin);
+      beatSpo2Value = calibratedSpo2Q8(Config::sensorModel, ratioQ8) / 256.0f;
+    } else {
+      // Float reference: R = (redAC / redDC) / (irAC / irDC)
+      float R = ((float)(redMax - redMin) / redMin) / ((float)(irMax - irMin) / irMin);
+      beatSpo2Value = calibratedSpo2(Config::sensorModel, R);
+    }
+    return beatSpo2Value;
+  }
+
+  // Fold the SpO2 of a beat the caller has accepted into the reading,
+  // smoothed 30/70 across beats and clamped. Beats from stretches of poor
+  // signal are left out, so they never reach the smoothed value.
+  void addSpo2(float beatSpo2) {
+    if (beatSpo2 <= 0) return;
+    if (Config::fixedPoint) {
+      int32_t spo2Q8 = lroundf(beatSpo2 * 256);  // Exact: measureSpo2() gave a Q8 value
+      if (spo2Value > 0) {
+        spo2Q8 = smoothSpo2Q8(spo2Q8, (int32_t)spo2Value << 8);
+      }
+      spo2Value = roundQ8(clampSpo2Q8(spo2Q8));
+    } else {
+      float newSpO2 = beatSpo2;
+      if (spo2Value > 0) {
+        newSpO2 = 0.3 * newSpO2 + 0.7 * spo2Value;
+      }
+      if (newSpO2 > 100) newSpO2 = 100;
+      if (newSpO2 < 80) newSpO2 = 80;
+      spo2Value = (int)(newSpO2 + 0.5);
+    }
+  }
+
+  // The LED or ADC settings changed: restart the baseline, band-pass, beat
+  // height and SpO2 windows at the new level, so the step isn't taken for a
+  // beat. Beat timing and the SpO2 estimate carry on.
+  void rebase() {
+    baseline.reset();
+    bandPass.reset();
+    beatDetector.rebase();
+    redWindow.reset();
+    irWindow.reset();
+    dcValue = 0;
+    acValue = 0;
+    unfilteredAcValue = 0;
+  }
+
+  long dc() const { return dcValue; }
+  long ac() const { return acValue; }  // Band-passed when Config::bandPass
+  long unfilteredAc() const { return unfilteredAcValue; }
+  int spo2() const { return spo2Value; }  // 0 until addSpo2() had a reading
+  float beatSpo2() const { return beatSpo2Value; }  // Of the last measureSpo2(); 0 if none
+  uint8_t beatConfidence() const { return beatDetector.confidence(); }  // 0-100, of the latest beat
+  bool templateReady() const { return beatTemplate.ready(); }
+
+private:
+  static_assert(Config::sampleRate % Config::sampleAverage == 0, "FIFO rate must be a whole number");
+  static_assert(1000 % Config::fifoSampleRate == 0, "Sample period must be a whole number of ms");
+  static_assert((uint32_t)Config::spo2Window * 1000 / Config::fifoSampleRate >= 60000UL / Config::minValidBpm,
+                "spo2Window is shorter than one beat at minValidBpm");
+  static_assert(Config::baselineIirShift <= 16, "IIR baseline state would overflow a long");
+  static_assert(0 < Config::bandPassLowHz && Config::bandPassLowHz < Config::bandPassHighHz &&
+                Config::bandPassHighHz < Config::fifoSampleRate / 2,
+                "Band-pass edges must satisfy 0 < low < high < Nyquist");
+  static_assert(highPassBiquad(Config::bandPassLowHz, Config::fifoSampleRate).a2 > 0 &&
+                lowPassBiquad(Config::bandPassHighHz, Config::fifoSampleRate).a2 > 0,
+                "Band-pass coefficients must be computable at compile time");
+
+  struct TemplateMatch {
+    const BeatTemplate<Config::templateSamples>& beatTemplate;
+    bool operator()(bool aboveThreshold) const {
+      if (!beatTemplate.ready()) return aboveThreshold;
+      int8_t needed = aboveThreshold ? (int8_t)Config::templateMinMatch : (int8_t)Config::templateMatch;
+      return beatTemplate.correlation() >= needed;
+    }
+  };
+
+  Baseline baseline;
+  BandPassFilter bandPass;
+  AdaptivePeakDetector beatDetector;
+  BeatTemplate<Config::templateSamples> beatTemplate;
+  SlidingExtrema<Config::spo2Window> redWindow;
+  SlidingExtrema<Config::spo2Window> irWindow;
+  long dcValue;
+  long acValue;
+  long unfilteredAcValue;
+  int spo2Value;
+  float beatSpo2Value;
+};
+
+#endif // PPG_PIPELINE_H
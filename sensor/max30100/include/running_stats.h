@@ -0,0 +1,47 @@
+// Running mean and variance (Welford's method)
+//
+// O(1) per value with no history kept, and numerically stable where the
+// textbook sum-of-squares formula loses the variance of large values
+// (beat intervals in ms) to float rounding.
+
+#ifndef RUNNING_STATS_H
+#define RUNNING_STATS_H
+
+#include <math.h>
+#include <stdint.h>
+
+class RunningStats {
+public:
+  RunningStats() { reset(); }
+
+  void reset() {
+    n = 0;
+    m = 0;
+    m2 = 0;
+  }
+
+  void add(float x) {
+    n++;
+    float delta = x - m;
+    m += delta / n;
+    m2 += delta * (x - m);
+  }
+
+  uint32_t count() const { return n; }
+  float mean() const { return m; }
+
+  // Sample variance, 0 with fewer than two values
+  float variance() const { return n > 1 ? m2 / (n - 1) : 0; }
+  float stddev() const { return sqrtf(variance()); }
+
+  // Half-width of the 95% confidence interval of the mean (normal
+  // approximation); infinite with fewer than two values
+  float ci95() const { return n > 1 ? 1.96f * stddev() / sqrtf(n) : INFINITY; }
+
+private:
+  uint32_t n;  // A continuous session can run past 65 535 values
+  float m;
+  float m2;
+};
+
+#endif // RUNNING_STATS_H
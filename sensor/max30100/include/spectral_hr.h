@@ -0,0 +1,212 @@
+// Heart rate from the spectrum of the AC signal
+//
+// A second estimate that doesn't depend on finding individual peaks. One
+// Goertzel filter per FFT bin of a 256-sample Hann-windowed window, run
+// only for the bins between MIN_BPM and MAX_BPM (a full FFT would spend
+// most of its work outside the heart rate band). Twiddles and the window
+// both come from one quarter-wave sine table in flash.
+//
+// The band-passed signal is averaged down by DECIMATION first, so the
+// window covers 256 * DECIMATION input samples (~10 s at 100 Hz / 4).
+// step() advances an analysis by a bounded number of window samples, so
+// the work is spread over loop ticks while new samples keep arriving.
+// Away from the firmware (no Arduino.h) the sine table is plain const
+// data, so the estimate can be checked on a host.
+
+#ifndef SPECTRAL_HR_H
+#define SPECTRAL_HR_H
+
+#include <math.h>
+#include <stdint.h>
+#include "history_ring.h"
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#define PROGMEM
+#define pgm_read_word(address) (*(const uint16_t*)(address))
+#endif
+
+#define SPECTRUM_WINDOW 256
+
+// sin(2 pi i / 256) in Q15, i = 0..64
+static const int16_t quarterSineQ15[65] PROGMEM = {
+  0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+  6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+  12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+  18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+  23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+  27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+  30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+  32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+  32767,
+};
+
+// sin / cos of i/256 of a turn in Q15
+inline int16_t sineQ15(uint8_t i) {
+  uint8_t q = i & 63;
+  switch (i >> 6) {
+    case 0: return (int16_t)pgm_read_word(&quarterSineQ15[q]);
+    case 1: return (int16_t)pgm_read_word(&quarterSineQ15[64 - q]);
+    case 2: return -(int16_t)pgm_read_word(&quarterSineQ15[q]);
+    default: return -(int16_t)pgm_read_word(&quarterSineQ15[64 - q]);
+  }
+}
+inline int16_t cosineQ15(uint8_t i) { return sineQ15(i + 64); }  // Wraps mod 256
+
+template <uint16_t FIFO_RATE, uint8_t DECIMATION, uint16_t MIN_BPM, uint16_t MAX_BPM>
+class SpectralHeartRate {
+public:
+  SpectralHeartRate() {
+    // Goertzel coefficient 2 cos(2 pi k / 256) in Q14 is cos in Q15
+    for (uint8_t b = 0; b < BINS; b++) coeffQ14[b] = cosineQ15(FIRST_BIN + b);
+    reset();
+  }
+
+  void reset() {
+    history.reset();
+    decimationSum = 0;
+    decimationCount = 0;
+    running = false;
+    nextStart = SPECTRUM_WINDOW;
+    estimate = 0;
+    share = 0;
+    completed = 0;
+  }
+
+  // Feed one band-passed AC sample at FIFO_RATE
+  void push(long ac) {
+    decimationSum += ac;
+    if (++decimationCount < DECIMATION) return;
+    long x = decimationSum / DECIMATION;
+    decimationSum = 0;
+    decimationCount = 0;
+    if (x > 32767) x = 32767;
+    if (x < -32768) x = -32768;
+    history.push((int16_t)x);
+  }
+
+  // Run up to maxSamples window samples through every bin. A new analysis
+  // of the newest window starts every HOP decimated samples once the first
+  // window has filled. True when an analysis has just completed.
+  bool step(uint16_t maxSamples) {
+    if (!running) {
+      if (history.total() < nextStart) return false;
+      windowStart = history.total() - SPECTRUM_WINDOW;
+      nextStart = history.total() + HOP;
+      position = 0;
+      for (uint8_t b = 0; b < BINS; b++) s1[b] = s2[b] = 0;
+      running = true;
+    }
+
+    // The analysis fell so far behind that its window was overwritten
+    unsigned long oldest = history.total() - history.size();
+    if (windowStart < oldest) {
+      running = false;
+      return false;
+    }
+
+    uint16_t end = position + maxSamples < SPECTRUM_WINDOW ? position + maxSamples : SPECTRUM_WINDOW;
+    for (; position < end; position++) {
+      long x = history.at(windowStart + position - oldest);
+      long hannQ15 = (32767L - cosineQ15(position)) / 2;
+      long windowed = (x * hannQ15) >> 15;
+      for (uint8_t b = 0; b < BINS; b++) {
+        long s = windowed + (long)(((int64_t)coeffQ14[b] * s1[b]) >> 14) - s2[b];
+        s2[b] = s1[b];
+        s1[b] = s;
+      }
+    }
+    if (position < SPECTRUM_WINDOW) return false;
+
+    running = false;
+    finishAnalysis();
+    return true;
+  }
+
+  float bpm() const { return estimate; }            // Latest estimate, 0 if none or no clear peak in range
+  uint8_t peakShare() const { return share; }       // % of in-band power around the peak
+  uint16_t analyses() const { return completed; }
+
+private:
+  static constexpr uint16_t RATE = FIFO_RATE / DECIMATION;
+  // Bins nearest MIN_BPM and MAX_BPM, and one beyond each for the interpolation
+  static constexpr uint8_t FIRST_BIN = ((uint32_t)MIN_BPM * SPECTRUM_WINDOW + 30UL * RATE) / (60UL * RATE) - 1;
+  static constexpr uint8_t LAST_BIN = ((uint32_t)MAX_BPM * SPECTRUM_WINDOW + 30UL * RATE) / (60UL * RATE) + 1;
+  static constexpr uint8_t BINS = LAST_BIN - FIRST_BIN + 1;
+  static constexpr uint16_t HOP = SPECTRUM_WINDOW / 4;
+  static constexpr uint16_t HISTORY = SPECTRUM_WINDOW + 32;  // Slack for samples arriving mid-analysis
+
+  static_assert(FIFO_RATE % DECIMATION == 0, "Decimated sample rate must be a whole number");
+  static_assert((uint32_t)MAX_BPM * 2 < 60UL * RATE, "MAX_BPM is above the decimated Nyquist frequency");
+  static_assert(FIRST_BIN >= 1 && LAST_BIN < SPECTRUM_WINDOW / 2, "Heart rate band must fit between DC and Nyquist");
+
+  // Power per bin, the strongest bin inside the band, and a parabolic fit
+  // over its neighbours for a rate finer than one bin (RATE * 60 / 256 BPM)
+  void finishAnalysis() {
+    float power[BINS];
+    for (uint8_t b = 0; b < BINS; b++) {
+      float a = s1[b], c = s2[b];
+      power[b] = a * a + c * c - (coeffQ14[b] / 16384.0f) * a * c;
+      if (power[b] < 0) power[b] = 0;
+    }
+
+    float total = 0;
+    uint8_t best = 1;
+    for (uint8_t b = 1; b < BINS - 1; b++) {
+      total += power[b];
+      if (power[b] > power[best]) best = b;
+    }
+    completed++;
+
+    // A pulse wave has a strong second harmonic; at low rates it can beat
+    // the fundamental, so take the bin at half the frequency if it holds a
+    // good part of the power
+    int half = (FIRST_BIN + best + 1) / 2 - FIRST_BIN;
+    if (half >= 2 && half < BINS - 1) {
+      uint8_t sub = power[half - 1] > power[half] ? half - 1 : half;
+      if (power[half + 1] > power[sub]) sub = half + 1;
+      if (power[sub] * 10 >= power[best] * 3) best = sub;
+    }
+    if (total <= 0) {
+      estimate = 0;
+      share = 0;
+      return;
+    }
+
+    float a = sqrtf(power[best - 1]), m = sqrtf(power[best]), c = sqrtf(power[best + 1]);
+    float denominator = a - 2 * m + c;
+    float offset = denominator != 0 ? 0.5f * (a - c) / denominator : 0;
+    estimate = (FIRST_BIN + best + offset) * RATE * 60.0f / SPECTRUM_WINDOW;
+    // A rate right on a band edge can interpolate a little past it
+    const float slack = RATE * 60.0f / SPECTRUM_WINDOW / 4;
+    if (estimate < MIN_BPM - slack || estimate > MAX_BPM + slack) {
+      estimate = 0;
+    } else if (estimate < MIN_BPM) {
+      estimate = MIN_BPM;
+    } else if (estimate > MAX_BPM) {
+      estimate = MAX_BPM;
+    }
+
+    float peak = power[best - 1] + power[best] + power[best + 1];
+    share = peak >= total ? 100 : (uint8_t)(100 * peak / total);
+  }
+
+  HistoryRing<int16_t, HISTORY> history;
+  long decimationSum;
+  uint8_t decimationCount;
+
+  int16_t coeffQ14[BINS];
+  long s1[BINS];
+  long s2[BINS];
+  bool running;
+  unsigned long windowStart;  // Sample number (since reset) of the window being analysed
+  unsigned long nextStart;    // Start the next analysis once this many samples have arrived
+  uint16_t position;
+
+  float estimate;
+  uint8_t share;
+  uint16_t completed;
+};
+
+#endif // SPECTRAL_HR_H
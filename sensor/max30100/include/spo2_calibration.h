@@ -0,0 +1,64 @@
+// SpO2 calibration: ratio of ratios R to SpO2, per sensor model
+//
+// Each model has a curve sampled every 1/8 of R from 0 to 2, stored in
+// flash and linearly interpolated. MAX30100 is the usual 110 - 25 * R line;
+// MAX30105 follows Maxim's calibration for its red/IR LEDs,
+// -45.060 * R^2 + 30.354 * R + 94.845, held at 100 below its peak (R ~ 0.34)
+// and at 0 past its zero. R above 2 reads as the last point. Away from the
+// firmware (no Arduino.h) the table is plain const data, so the lookup
+// can be checked on a host against reference R values.
+
+#ifndef SPO2_CALIBRATION_H
+#define SPO2_CALIBRATION_H
+
+#include <stdint.h>
+#include "config.h"
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#else
+#define PROGMEM
+#define pgm_read_word(address) (*(const uint16_t*)(address))
+#endif
+
+#define SPO2_TABLE_POINTS 17
+#define SPO2_TABLE_STEP_SHIFT 5  // Points are 32 apart in Q8 R (1/8)
+
+// SpO2 in Q8 at R = i / 8, one row per SensorModel
+static const int16_t spo2CalibrationQ8[2][SPO2_TABLE_POINTS] PROGMEM = {
+  // SENSOR_MAX30100
+  {28160, 27360, 26560, 25760, 24960, 24160, 23360, 22560, 21760,
+   20960, 20160, 19360, 18560, 17760, 16960, 16160, 15360},
+  // SENSOR_MAX30105
+  {25600, 25600, 25600, 25572, 25282, 24631, 23620, 22248, 20516,
+   18423, 15970, 13156, 9982, 6447, 2552, 0, 0},
+};
+
+inline int32_t spo2TablePoint(SensorModel model, uint8_t index) {
+  return (int16_t)pgm_read_word(&spo2CalibrationQ8[model][index]);
+}
+
+// SpO2 for R, both Q8
+inline int32_t calibratedSpo2Q8(SensorModel model, uint32_t ratioQ8) {
+  const uint8_t last = SPO2_TABLE_POINTS - 1;
+  if (ratioQ8 >= ((uint32_t)last << SPO2_TABLE_STEP_SHIFT)) return spo2TablePoint(model, last);
+  uint8_t index = ratioQ8 >> SPO2_TABLE_STEP_SHIFT;
+  int32_t fraction = ratioQ8 & ((1 << SPO2_TABLE_STEP_SHIFT) - 1);
+  int32_t low = spo2TablePoint(model, index);
+  int32_t high = spo2TablePoint(model, index + 1);
+  return low + (high - low) * fraction / (1 << SPO2_TABLE_STEP_SHIFT);
+}
+
+// Float reference of the same lookup
+inline float calibratedSpo2(SensorModel model, float ratio) {
+  const uint8_t last = SPO2_TABLE_POINTS - 1;
+  float position = ratio * (256 >> SPO2_TABLE_STEP_SHIFT);
+  if (position < 0) position = 0;
+  if (position >= last) return spo2TablePoint(model, last) / 256.0f;
+  uint8_t index = (uint8_t)position;
+  float fraction = position - index;
+  float low = spo2TablePoint(model, index), high = spo2TablePoint(model, index + 1);
+  return (low + (high - low) * fraction) / 256.0f;
+}
+
+#endif // SPO2_CALIBRATION_H
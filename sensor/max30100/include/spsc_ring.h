@@ -0,0 +1,61 @@
+// Lock-free single-producer/single-consumer ring buffer
+//
+// Safe between one interrupt handler (producer) and loop() (consumer) on a
+// single-core MCU: each index is written by one side only, and a compiler
+// barrier keeps the slot write ahead of the index update. push() is forced
+// inline so an IRAM interrupt handler never calls out to flash for it (on
+// the ESP8266 flash may be unreadable while the ISR runs).
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+
+#define SPSC_BARRIER() __asm__ __volatile__("" ::: "memory")
+#define SPSC_ALWAYS_INLINE inline __attribute__((always_inline))
+
+// N must be a power of two; one slot is kept free to tell full from empty
+template <typename T, uint8_t N>
+class SpscRing {
+public:
+  SpscRing() : head(0), tail(0), overflows(0) {}
+
+  // Producer side; returns false (and counts an overflow) when full
+  SPSC_ALWAYS_INLINE bool push(const T& item) {
+    uint8_t h = head;
+    uint8_t next = (h + 1) & MASK;
+    if (next == tail) {
+      overflows++;
+      return false;
+    }
+    items[h] = item;
+    SPSC_BARRIER();
+    head = next;
+    return true;
+  }
+
+  // Consumer side; returns false when empty
+  bool pop(T& item) {
+    uint8_t t = tail;
+    if (t == head) return false;
+    item = items[t];
+    SPSC_BARRIER();
+    tail = (t + 1) & MASK;
+    return true;
+  }
+
+  bool empty() const { return head == tail; }
+  uint8_t size() const { return (head - tail) & MASK; }
+  unsigned long overflowCount() const { return overflows; }
+
+private:
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+  static const uint8_t MASK = N - 1;
+
+  T items[N];
+  volatile uint8_t head;
+  volatile uint8_t tail;
+  volatile unsigned long overflows;
+};
+
+#endif // SPSC_RING_H
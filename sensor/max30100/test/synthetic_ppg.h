@@ -0,0 +1,97 @@
+// Synthetic PPG traces for the host tests
+//
+// A pulse wave (systolic peak and a smaller dicrotic wave) at a fixed
+// rate, scaled to a pulse amplitude in ADC counts, with optional Gaussian
+// noise, missing beats and (on IR/Red) slow baseline wander. Samples are produced one at a time at the FIFO
+// rate, either as the AC part alone (for the peak detector) or as IR/Red
+// on top of a DC level with a given ratio of ratios (for PpgPipeline).
+// Repeatable: the noise comes from a seeded LCG.
+
+#ifndef SYNTHETIC_PPG_H
+#define SYNTHETIC_PPG_H
+
+#include <math.h>
+#include <stdint.h>
+
+class SyntheticPpg {
+public:
+  SyntheticPpg(float bpm, float amplitude, float noise = 0, uint32_t seed = 1, uint16_t sampleRate = 100)
+    : beatsPerSample(bpm / 60.0f / sampleRate), pulseAmplitude(amplitude), noiseLevel(noise),
+      rate(sampleRate), state(seed), phase(0.999f), sample(0), beats(0), missing(0), dicroticShare(0.35f), wander(0) {}
+
+  // Height of the dicrotic wave as a share of the systolic one (0.35 by
+  // default; the band-pass leaves little of it)
+  void setDicrotic(float share) { dicroticShare = share; }
+
+  // Baseline wander (breathing, pressure) of this many counts at 0.11 Hz, on IR/Red only
+  void setWander(float amplitude) { wander = amplitude; }
+
+  // Leave beat number `index` (0 = the first) out of the trace
+  void dropBeat(uint16_t index) {
+    if (index < 32) missing |= 1UL << index;
+  }
+
+  // Next AC sample in ADC counts
+  float nextAc() {
+    phase += beatsPerSample;
+    if (phase >= 1) {
+      phase -= 1;
+      beats++;
+    }
+    sample++;
+    float value = dropped(beats - 1) ? 0 : pulseAmplitude * shape(phase);
+    return value + noiseLevel * gaussian();
+  }
+
+  // Next IR/Red pair on DC levels irDc/redDc, Red pulsing with ratio of ratios r
+  void nextIrRed(long irDc, long redDc, float r, long& ir, long& red) {
+    float ac = nextAc();
+    float drift = wander * sinf(0.7f * sample / rate);
+    ir = irDc + lroundf(ac + drift);
+    red = redDc + lroundf((ac * r + drift) * redDc / irDc);
+  }
+
+  unsigned long timeMs() const { return sample * 1000UL / rate; }  // Of the latest sample
+  uint16_t beatsGenerated() const {                                 // Beats begun so far, less the dropped ones
+    uint16_t count = 0;
+    for (uint16_t i = 0; i < beats; i++) {
+      if (!dropped(i)) count++;
+    }
+    return count;
+  }
+
+private:
+  bool dropped(uint16_t index) const { return index < 32 && (missing >> index) & 1; }
+
+  // One beat over phase 0..1: the systolic wave peaks at 0.15, the
+  // dicrotic wave at 0.45. Zero mean over a beat.
+  float shape(float p) const {
+    float systolic = expf(-sq((p - 0.15f) / 0.07f));
+    float dicrotic = dicroticShare * expf(-sq((p - 0.45f) / 0.06f));
+    return systolic + dicrotic - 0.1241f - dicroticShare * 0.1063f;
+  }
+  static float sq(float x) { return x * x; }
+
+  float uniform() {
+    state = state * 1664525UL + 1013904223UL;
+    return ((state >> 8) + 0.5f) / 16777216.0f;
+  }
+  float gaussian() {
+    if (noiseLevel == 0) return 0;
+    return sqrtf(-2 * logf(uniform())) * cosf(6.2831853f * uniform());
+  }
+
+  float beatsPerSample;
+  float pulseAmplitude;
+  float noiseLevel;
+  uint16_t rate;
+  uint32_t state;
+  float phase;
+  unsigned long sample;
+  uint16_t beats;
+  uint32_t missing;
+  float dicroticShare;
+  float wander;
+};
+
+#endif // SYNTHETIC_PPG_H
@@ -0,0 +1,92 @@
+// Integer SpO2/BPM/baseline math against the float reference it replaces
+//
+// Runs on the host: pio test -e native (from sensor/max30100)
+
+#include <math.h>
+#include <stdint.h>
+#include <unity.h>
+#include "baseline_estimator.h"
+#include "fixed_point_dsp.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Repeatable pseudo-random inputs (LCG)
+static uint32_t seed;
+static uint32_t nextRandom(uint32_t limit) {
+  seed = seed * 1664525UL + 1013904223UL;
+  return (seed >> 8) % limit;
+}
+
+// Red and IR at 20 000 counts to 18-bit full scale, AC 0.1-5 % of DC
+void test_ratio_of_ratios_matches_float() {
+  seed = 1;
+  for (uint32_t i = 0; i < 200000; i++) {
+    uint32_t redDC = 20000 + nextRandom(242000), irDC = 20000 + nextRandom(242000);
+    uint32_t redAC = redDC / 1000 + nextRandom(redDC / 20), irAC = irDC / 1000 + nextRandom(irDC / 20);
+    float expected = ((float)redAC / redDC) / ((float)irAC / irDC);
+    if (expected > 4) continue;  // Far outside any SpO2 curve
+    TEST_ASSERT_FLOAT_WITHIN(0.015f, expected, ratioOfRatiosQ8(redAC, redDC, irAC, irDC) / 256.0f);
+  }
+}
+
+// Extreme ratios must not wrap around to a plausible R
+void test_ratio_of_ratios_extremes() {
+  TEST_ASSERT_GREATER_OR_EQUAL(0xFFFF, ratioOfRatiosQ8(100000, 1000, 1, 100000));
+  TEST_ASSERT_GREATER_OR_EQUAL(0xFFFF, ratioOfRatiosQ8(262143, 1, 1, 262143));
+  TEST_ASSERT_EQUAL_UINT32(0, ratioOfRatiosQ8(100, 1000, 0, 1000));  // No IR pulse
+}
+
+// 30/70 smoothing, clamp to 80-100 and rounding, as PpgPipeline applies them
+void test_spo2_smoothing_matches_float() {
+  seed = 2;
+  for (uint32_t i = 0; i < 100000; i++) {
+    int32_t newQ8 = (int32_t)nextRandom(40 << 8) + (70 << 8);  // 70-110 %
+    int previous = 80 + (int)nextRandom(21);
+    int fixed = roundQ8(clampSpo2Q8(smoothSpo2Q8(newQ8, (int32_t)previous << 8)));
+
+    float smoothed = 0.3f * (newQ8 / 256.0f) + 0.7f * previous;
+    if (smoothed > 100) smoothed = 100;
+    if (smoothed < 80) smoothed = 80;
+    TEST_ASSERT_INT_WITHIN(1, (int)(smoothed + 0.5f), fixed);
+  }
+}
+
+void test_bpm_tenths_matches_float() {
+  seed = 3;
+  for (uint32_t i = 0; i < 100000; i++) {
+    uint32_t intervals = 1 + nextRandom(250);
+    uint32_t spanMs = intervals * (273 + nextRandom(1227));  // 40-220 BPM
+    float expected = intervals * 60000.0f / spanMs;
+    TEST_ASSERT_FLOAT_WITHIN(0.051f, expected, bpmTenths(intervals, spanMs) / 10.0f);
+  }
+  TEST_ASSERT_EQUAL(0, bpmTenths(3, 0));
+}
+
+// Running-sum moving average against a float mean over the same window
+void test_moving_average_baseline_matches_float() {
+  static const uint16_t WINDOW = 100;
+  static long history[2000];
+  MovingAverageBaseline<WINDOW> baseline;
+  seed = 4;
+  for (uint16_t n = 0; n < 2000; n++) {
+    history[n] = 100000 + (long)(2000 * sin(n * 0.075)) + (long)nextRandom(200);
+    long fixed = baseline.update(history[n]);
+
+    uint16_t first = n + 1 > WINDOW ? n + 1 - WINDOW : 0;
+    double sum = 0;
+    for (uint16_t k = first; k <= n; k++) sum += history[k];
+    TEST_ASSERT_FLOAT_WITHIN(1.0, sum / (n + 1 - first), fixed);
+  }
+  TEST_ASSERT_TRUE(baseline.ready());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_ratio_of_ratios_matches_float);
+  RUN_TEST(test_ratio_of_ratios_extremes);
+  RUN_TEST(test_spo2_smoothing_matches_float);
+  RUN_TEST(test_bpm_tenths_matches_float);
+  RUN_TEST(test_moving_average_baseline_matches_float);
+  return UNITY_END();
+}
@@ -0,0 +1,144 @@
+// LedAutoGain driving PpgPipeline the way processSample() does, on a
+// simulated sensor read in FIFO bursts
+//
+// The sensor scales a finger's reflectance by LED amplitude / 255 and
+// 16384 nA / ADC range, clipped at 18-bit full scale. New settings take
+// effect from the sample being averaged when they are written, i.e. the
+// one after the current burst. Every beat detected must be a real
+// systolic peak: the level step at a gain change must not pass for one.
+//
+// Runs on the host: pio test -e native (from sensor/max30100)
+
+#include <math.h>
+#include <stdint.h>
+#include <unity.h>
+#include "config.h"
+#include "led_agc.h"
+#include "ppg_pipeline.h"
+#include "../synthetic_ppg.h"
+
+typedef NodeMcuConfig Config;
+
+static const uint8_t BURST = 5;   // Samples per FIFO read
+static const float RATE_BPM = 72;
+
+struct Outcome {
+  uint16_t detected;
+  uint16_t spurious;     // Detected beats more than 60 ms from a systolic peak
+  uint16_t peaks;        // Systolic peaks in the trace
+  uint8_t changes;
+  uint32_t settledIr;    // IR level at the end
+};
+
+static Outcome simulate(float reflectance, uint16_t seconds) {
+  static PpgPipeline<Config> ppg;
+  ppg.reset();
+  LedAutoGain gain(adcFullScale(Config::pulseWidth), Config::agcTargetPercent, Config::agcTolerancePercent,
+                   Config::agcMinAmplitude, Config::ledBrightness, Config::adcRange, Config::agcBlockSamples,
+                   Config::agcWarmupSamples, Config::agcMinLevel);
+  gain.start();
+  SyntheticPpg pulse(RATE_BPM, 1.0f);
+  pulse.setDicrotic(0.2f);
+
+  uint32_t total = seconds * Config::fifoSampleRate;
+  static uint32_t ir[6000];
+  static unsigned long peakTimes[200];
+  uint16_t peakCount = 0;
+  float previousShape = 0, shape = 0;
+
+  // Sensor side: levels with the settings in force when each sample was taken
+  uint8_t irAmp = gain.irAmplitude();
+  uint16_t rangeNa = gain.adcRangeNa();
+  uint32_t appliedFrom = 0;
+  uint8_t pendingAmp = irAmp;
+  uint16_t pendingRange = rangeNa;
+  for (uint32_t n = 0; n < total; n++) {
+    float next = pulse.nextAc();
+    if (n > 0 && shape > previousShape && shape > next && shape > 0.5f && peakCount < 200) {
+      peakTimes[peakCount++] = (n - 1) * 10;
+    }
+    previousShape = shape;
+    shape = next;
+  }
+
+  SyntheticPpg trace(RATE_BPM, 1.0f);
+  trace.setDicrotic(0.2f);
+  Outcome outcome = {0, 0, peakCount, 0, 0};
+  for (uint32_t burstStart = 0; burstStart < total; burstStart += BURST) {
+    // The sensor takes this burst's samples with the settings in force
+    for (uint32_t n = burstStart; n < burstStart + BURST && n < total; n++) {
+      if (n >= appliedFrom) {
+        irAmp = pendingAmp;
+        rangeNa = pendingRange;
+      }
+      float level = reflectance * irAmp / 255.0f * 16384.0f / rangeNa;
+      float counts = level * (1 + 0.01f * trace.nextAc());
+      ir[n] = counts > 262143 ? 262143 : (uint32_t)counts;
+    }
+
+    // The firmware processes it
+    uint32_t burstEnd = burstStart + BURST < total ? burstStart + BURST : total;
+    for (uint32_t n = burstStart; n < burstEnd; n++) {
+      uint8_t available = burstEnd - 1 - n;
+      AgcAction action = gain.update(ir[n], ir[n] * 4 / 5, available + Config::agcSettleSamples);
+      if (action == AGC_APPLY) {
+        pendingAmp = gain.irAmplitude();
+        pendingRange = gain.adcRangeNa();
+        appliedFrom = burstEnd;  // The sample being averaged when the write lands
+        outcome.changes++;
+      } else if (action == AGC_REBASE) {
+        ppg.rebase();
+      }
+      if (ir[n] < (uint32_t)Config::fingerPresenceThreshold) continue;
+
+      bool beat = ppg.update(ir[n], ir[n] * 4 / 5, n * 10);
+      if (!beat || gain.settling()) continue;
+      outcome.detected++;
+      bool real = false;
+      for (uint16_t p = 0; p < peakCount; p++) {
+        long offset = (long)(n * 10) - (long)peakTimes[p];
+        if (offset >= -60 && offset <= 60) real = true;
+      }
+      if (!real) outcome.spurious++;
+    }
+  }
+  outcome.settledIr = ir[total - 1];
+  return outcome;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Bright finger: clipped at first, the LED current comes down
+void test_bright_finger_no_beat_at_gain_change() {
+  Outcome outcome = simulate(300000, 20);
+  TEST_ASSERT_GREATER_OR_EQUAL(1, outcome.changes);
+  TEST_ASSERT_EQUAL(0, outcome.spurious);
+  TEST_ASSERT_INT_WITHIN(3, outcome.peaks, outcome.detected);
+  TEST_ASSERT_INT_WITHIN(262143 * (Config::agcTolerancePercent + 5) / 100, 262143 * Config::agcTargetPercent / 100,
+                         outcome.settledIr);
+}
+
+// Weak finger: the ADC range steps down (x8 counts) with the LED at maximum
+void test_weak_finger_no_beat_at_range_change() {
+  Outcome outcome = simulate(20400, 20);
+  TEST_ASSERT_GREATER_OR_EQUAL(1, outcome.changes);
+  TEST_ASSERT_EQUAL(0, outcome.spurious);
+  TEST_ASSERT_INT_WITHIN(3, outcome.peaks, outcome.detected);
+  TEST_ASSERT_INT_WITHIN(262143 * (Config::agcTolerancePercent + 5) / 100, 262143 * Config::agcTargetPercent / 100,
+                         outcome.settledIr);
+}
+
+// Already in range: nothing is changed
+void test_in_range_finger_left_alone() {
+  Outcome outcome = simulate(131000, 10);
+  TEST_ASSERT_EQUAL(0, outcome.changes);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_bright_finger_no_beat_at_gain_change);
+  RUN_TEST(test_weak_finger_no_beat_at_range_change);
+  RUN_TEST(test_in_range_finger_left_alone);
+  return UNITY_END();
+}
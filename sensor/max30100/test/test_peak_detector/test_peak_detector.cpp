@@ -0,0 +1,87 @@
+// AdaptivePeakDetector on synthetic pulse waves, with the NodeMcuConfig settings
+//
+// Runs on the host: pio test -e native (from sensor/max30100)
+
+#include <math.h>
+#include <stdint.h>
+#include <unity.h>
+#include "config.h"
+#include "peak_detector.h"
+#include "../synthetic_ppg.h"
+
+typedef NodeMcuConfig Config;
+
+static AdaptivePeakDetector newDetector() {
+  return AdaptivePeakDetector(Config::beatAcThreshold, Config::minBeatInterval, 60000UL / Config::minValidBpm,
+                              Config::beatThresholdPercent, Config::beatRefractoryPercent, Config::beatEnvelopeShift);
+}
+
+// Feed `seconds` of the trace (scaled by `gain`); returns the beats detected
+static uint16_t run(AdaptivePeakDetector& detector, SyntheticPpg& trace, uint16_t seconds, float gain = 1) {
+  uint16_t detected = 0;
+  for (uint32_t n = 0; n < seconds * 100UL; n++) {
+    long ac = lroundf(trace.nextAc() * gain);
+    if (detector.update(ac, trace.timeMs())) detected++;
+  }
+  return detected;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Every beat once: the dicrotic wave is not a second beat
+void test_steady_rate_counts_every_beat() {
+  AdaptivePeakDetector detector = newDetector();
+  SyntheticPpg trace(75, 500, 5);
+  uint16_t detected = run(detector, trace, 30);
+  TEST_ASSERT_INT_WITHIN(1, trace.beatsGenerated(), detected);
+  TEST_ASSERT_INT_WITHIN(20, 800, detector.interval());
+  TEST_ASSERT_GREATER_OR_EQUAL(80, detector.confidence());
+}
+
+// A missed second beat must not lock the detector to half the rate. Beat 0
+// falls inside the first minInterval and is never seen, so beat 1 is the
+// first detected and beat 2 the one missed. With no dicrotic wave there is
+// no stray peak to break the lock by chance.
+static void checkRecoversFromMissedBeat(float bpm, uint16_t missedBeat) {
+  AdaptivePeakDetector detector = newDetector();
+  SyntheticPpg trace(bpm, 500, 5);
+  trace.setDicrotic(0);
+  trace.dropBeat(0);
+  trace.dropBeat(missedBeat);
+  uint16_t detected = run(detector, trace, 30);
+  TEST_ASSERT_INT_WITHIN(2, trace.beatsGenerated(), detected);
+  TEST_ASSERT_INT_WITHIN(30, lroundf(60000 / bpm), detector.interval());
+}
+
+void test_missed_second_beat_at_100_bpm() { checkRecoversFromMissedBeat(100, 2); }
+void test_missed_second_beat_at_120_bpm() { checkRecoversFromMissedBeat(120, 2); }
+void test_missed_beat_after_seeding() { checkRecoversFromMissedBeat(90, 7); }
+
+// The threshold follows the beat height down after a strong stretch
+void test_weaker_beats_after_strong_ones() {
+  AdaptivePeakDetector detector = newDetector();
+  SyntheticPpg trace(70, 200, 3);
+  run(detector, trace, 10, 4);
+  uint16_t before = trace.beatsGenerated();
+  uint16_t detected = run(detector, trace, 20);
+  TEST_ASSERT_INT_WITHIN(2, trace.beatsGenerated() - before, detected);
+}
+
+// Noise under the threshold floor is not beats
+void test_noise_alone_is_not_beats() {
+  AdaptivePeakDetector detector = newDetector();
+  SyntheticPpg trace(70, 0, 10);
+  TEST_ASSERT_EQUAL(0, run(detector, trace, 30));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_steady_rate_counts_every_beat);
+  RUN_TEST(test_missed_second_beat_at_100_bpm);
+  RUN_TEST(test_missed_second_beat_at_120_bpm);
+  RUN_TEST(test_missed_beat_after_seeding);
+  RUN_TEST(test_weaker_beats_after_strong_ones);
+  RUN_TEST(test_noise_alone_is_not_beats);
+  return UNITY_END();
+}
@@ -0,0 +1,130 @@
+// SignalQuality beat morphology on synthetic pulse waves, and the quality
+// gate on a trace with a motion artifact
+//
+// Runs on the host: pio test -e native (from sensor/max30100)
+
+#include <math.h>
+#include <stdint.h>
+#include <unity.h>
+#include "config.h"
+#include "history_ring.h"
+#include "ppg_pipeline.h"
+#include "signal_quality.h"
+#include "../synthetic_ppg.h"
+
+typedef NodeMcuConfig Config;
+typedef SignalQuality<Config::qualityWindow, Config::beatShapeSamples> Quality;
+
+// 60 BPM at 100 Hz: beat k peaks at sample 100 k + 15
+static const uint16_t BEAT_SAMPLES = 100;
+static const uint16_t PEAK_OFFSET = 15;
+
+// Feed one beat, inverted if `artifact`; at its peak score it and keep it
+// if it correlates well enough. Returns the correlation.
+static int8_t feedBeat(Quality& quality, SyntheticPpg& trace, bool artifact) {
+  int8_t correlation = 0;
+  for (uint16_t n = 0; n < BEAT_SAMPLES; n++) {
+    long ac = lroundf(trace.nextAc());
+    if (artifact) ac = -ac;
+    quality.update(100000, ac, ac);
+    if (n == PEAK_OFFSET) {
+      correlation = quality.beat();
+      quality.keepBeat(correlation >= Config::minBeatCorrelation);
+    }
+  }
+  return correlation;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_repeating_pulse_correlates() {
+  Quality quality(Config::minPerfusion, Config::maxPerfusion, Config::minSignalQuality);
+  SyntheticPpg trace(60, 500, 10);
+  for (uint8_t k = 0; k < 10; k++) {
+    TEST_ASSERT_GREATER_OR_EQUAL(90, feedBeat(quality, trace, false));
+  }
+  TEST_ASSERT_TRUE(quality.usable());
+  TEST_ASSERT_GREATER_OR_EQUAL(90, quality.morphologyPercent());
+}
+
+// A rejected artifact must not become the reference for the next beat
+void test_artifact_does_not_reject_the_next_beat() {
+  Quality quality(Config::minPerfusion, Config::maxPerfusion, Config::minSignalQuality);
+  SyntheticPpg trace(60, 500, 10);
+  for (uint8_t k = 0; k < 5; k++) feedBeat(quality, trace, false);
+  TEST_ASSERT_LESS_THAN(Config::minBeatCorrelation, feedBeat(quality, trace, true));
+  TEST_ASSERT_GREATER_OR_EQUAL(Config::minBeatCorrelation, feedBeat(quality, trace, false));
+}
+
+// A lasting change of shape is relearned after a run of rejections
+void test_lasting_shape_change_is_relearned() {
+  Quality quality(Config::minPerfusion, Config::maxPerfusion, Config::minSignalQuality);
+  SyntheticPpg trace(60, 500, 10);
+  for (uint8_t k = 0; k < 5; k++) feedBeat(quality, trace, false);
+  uint8_t rejected = 0;
+  for (uint8_t k = 0; k < 10; k++) {
+    if (feedBeat(quality, trace, true) < Config::minBeatCorrelation) rejected++;
+  }
+  TEST_ASSERT_INT_WITHIN(1, 4, rejected);
+}
+
+// 72 BPM through PpgPipeline with a 2 s motion artifact (a large swing
+// plus broadband noise) from 20.5 s, halfway into a quality window. As in
+// the firmware, beats wait until their window has been scored. None found
+// during the artifact may be kept, and the clean beats after it must be.
+void test_artifact_mid_window_is_excluded() {
+  static PpgPipeline<Config> ppg;  // Static: the pipeline holds a few KB of windows
+  ppg.reset();
+  Quality quality(Config::minPerfusion, Config::maxPerfusion, Config::minSignalQuality);
+  SyntheticPpg trace(72, 800, 10, 3);
+  const unsigned long artifactStart = 20500, artifactEnd = 22500;
+  const float period = 60000.0f / 72;
+
+  HistoryRing<unsigned long, 16> held;
+  HistoryRing<unsigned long, 64> kept;
+  uint32_t noise = 7;
+  for (uint32_t n = 0; n < 3000; n++) {
+    long ir, red;
+    trace.nextIrRed(100000, 60000, 0.6f, ir, red);
+    unsigned long t = n * 10;
+    if (t >= artifactStart && t < artifactEnd) {
+      noise = noise * 1664525UL + 1013904223UL;
+      long motion = lroundf(8000 * sinf(3.1416f * (t - artifactStart) / 1000) +
+                            ((noise >> 8) / 16777216.0f - 0.5f) * 6000);
+      ir += motion;
+      red += motion * 6 / 10;
+    }
+    if (ppg.update(ir, red, t)) {
+      bool shapeOk = quality.beat() >= Config::minBeatCorrelation;
+      quality.keepBeat(shapeOk);
+      if (shapeOk) held.push(t);
+    }
+    if (quality.update(ppg.dc(), ppg.unfilteredAc(), ppg.ac())) {
+      for (uint16_t i = 0; quality.usable() && i < held.size(); i++) kept.push(held.at(i));
+      held.reset();
+    }
+  }
+
+  // Every kept beat sits on the pulse's rhythm, none inside the artifact
+  unsigned long first = kept.at(0);
+  uint16_t keptAfter = 0;
+  for (uint16_t i = 0; i < kept.size(); i++) {
+    unsigned long t = kept.at(i);
+    TEST_ASSERT_FALSE(t >= artifactStart && t < artifactEnd);
+    float offset = fmodf(t - first + period / 2, period) - period / 2;
+    TEST_ASSERT_FLOAT_WITHIN(20, 0, offset);
+    if (t >= 24000) keptAfter++;
+  }
+  // Beats from 24 s (two windows on from the artifact's start) are kept: 24.3 .. 29.3 s
+  TEST_ASSERT_EQUAL(7, keptAfter);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_repeating_pulse_correlates);
+  RUN_TEST(test_artifact_does_not_reject_the_next_beat);
+  RUN_TEST(test_lasting_shape_change_is_relearned);
+  RUN_TEST(test_artifact_mid_window_is_excluded);
+  return UNITY_END();
+}
@@ -0,0 +1,80 @@
+// SpectralHeartRate on synthetic pulse waves and tones
+//
+// Runs on the host: pio test -e native (from sensor/max30100)
+
+#include <math.h>
+#include <stdint.h>
+#include <unity.h>
+#include "config.h"
+#include "spectral_hr.h"
+#include "../synthetic_ppg.h"
+
+typedef NodeMcuConfig Config;
+typedef SpectralHeartRate<Config::fifoSampleRate, Config::spectralDecimation,
+                          Config::minValidBpm, Config::maxValidBpm> Spectrum;
+
+// 20 s of input, enough for several analyses of the 10 s window; step()
+// gets the same slice per sample as the firmware gives it per tick
+static const uint16_t SAMPLES = 2000;
+
+void setUp() {}
+void tearDown() {}
+
+// A pulse wave (with its dicrotic wave and noise) anywhere in the valid
+// range reads within 0.5 BPM, rates on the band edges included
+void test_tracks_pulse_across_valid_range() {
+  for (uint16_t bpm = Config::minValidBpm; bpm <= Config::maxValidBpm; bpm += 4) {
+    Spectrum spectrum;
+    SyntheticPpg trace(bpm, 500, 20, bpm);
+    for (uint16_t n = 0; n < SAMPLES; n++) {
+      spectrum.push(lroundf(trace.nextAc()));
+      spectrum.step(Config::spectralSamplesPerTick);
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(4, spectrum.analyses());
+    TEST_ASSERT_FLOAT_WITHIN(0.5f, bpm, spectrum.bpm());
+  }
+}
+
+// Fundamental f and second harmonic 2f at the given amplitudes, in counts
+static float harmonicRate(float bpm, float fundamental, float harmonic) {
+  Spectrum spectrum;
+  for (uint16_t n = 0; n < SAMPLES; n++) {
+    float phase = 6.2831853f * bpm / 60 * n / Config::fifoSampleRate;
+    spectrum.push(lroundf(fundamental * sinf(phase) + harmonic * sinf(2 * phase)));
+    spectrum.step(Config::spectralSamplesPerTick);
+  }
+  return spectrum.bpm();
+}
+
+// At low rates the second harmonic can outweigh the fundamental; the
+// estimate still falls back to the fundamental
+void test_second_harmonic_falls_back_to_fundamental() {
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 50, harmonicRate(50, 400, 600));
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 45, harmonicRate(45, 300, 500));
+}
+
+// With nothing at half the frequency the strongest bin stands
+void test_lone_tone_is_not_halved() {
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 100, harmonicRate(50, 0, 500));
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 120, harmonicRate(60, 40, 500));
+}
+
+// No signal, no estimate
+void test_silence_has_no_estimate() {
+  Spectrum spectrum;
+  for (uint16_t n = 0; n < SAMPLES; n++) {
+    spectrum.push(0);
+    spectrum.step(Config::spectralSamplesPerTick);
+  }
+  TEST_ASSERT_EQUAL_FLOAT(0, spectrum.bpm());
+  TEST_ASSERT_EQUAL(0, spectrum.peakShare());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_tracks_pulse_across_valid_range);
+  RUN_TEST(test_second_harmonic_falls_back_to_fundamental);
+  RUN_TEST(test_lone_tone_is_not_halved);
+  RUN_TEST(test_silence_has_no_estimate);
+  return UNITY_END();
+}
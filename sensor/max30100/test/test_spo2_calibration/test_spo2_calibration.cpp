@@ -0,0 +1,74 @@
+// SpO2 calibration table lookup against the curves it samples
+//
+// Runs on the host: pio test -e native (from sensor/max30100)
+
+#include <math.h>
+#include <stdint.h>
+#include <unity.h>
+#include "spo2_calibration.h"
+
+void setUp() {}
+void tearDown() {}
+
+// Maxim's MAX30105 curve, held at 100 below its peak and at 0 past its zero
+static float maximSpo2(float r) {
+  if (r < 0.337f) return 100;
+  float spo2 = -45.060f * r * r + 30.354f * r + 94.845f;
+  return spo2 > 0 ? spo2 : 0;
+}
+
+// A straight line is exact at every table step
+void test_max30100_matches_linear_curve() {
+  for (uint32_t ratioQ8 = 0; ratioQ8 <= 512; ratioQ8++) {
+    float r = ratioQ8 / 256.0f;
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 110 - 25 * r, calibratedSpo2Q8(SENSOR_MAX30100, ratioQ8) / 256.0f);
+  }
+}
+
+// Linear interpolation of the quadratic stays within 0.3 points over the
+// usable range (R up to 1.2, SpO2 down to about 66)
+void test_max30105_matches_maxim_curve() {
+  for (uint32_t ratioQ8 = 0; ratioQ8 <= 307; ratioQ8++) {
+    float r = ratioQ8 / 256.0f;
+    TEST_ASSERT_FLOAT_WITHIN(0.3f, maximSpo2(r), calibratedSpo2Q8(SENSOR_MAX30105, ratioQ8) / 256.0f);
+  }
+}
+
+// Reference points: typical readings for a healthy and a hypoxic finger
+void test_reference_ratios() {
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 97.5f, calibratedSpo2Q8(SENSOR_MAX30100, 128) / 256.0f);  // R 0.5
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 85.0f, calibratedSpo2Q8(SENSOR_MAX30100, 256) / 256.0f);  // R 1.0
+  TEST_ASSERT_FLOAT_WITHIN(0.3f, 98.7f, calibratedSpo2Q8(SENSOR_MAX30105, 128) / 256.0f);   // R 0.5
+  TEST_ASSERT_FLOAT_WITHIN(0.3f, 94.0f, calibratedSpo2Q8(SENSOR_MAX30105, 179) / 256.0f);   // R 0.7
+  TEST_ASSERT_FLOAT_WITHIN(0.3f, 80.1f, calibratedSpo2Q8(SENSOR_MAX30105, 256) / 256.0f);   // R 1.0
+}
+
+// The float lookup is the same table
+void test_float_lookup_matches_fixed_point() {
+  for (uint32_t ratioQ8 = 0; ratioQ8 <= 600; ratioQ8++) {
+    float r = ratioQ8 / 256.0f;
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, calibratedSpo2Q8(SENSOR_MAX30100, ratioQ8) / 256.0f,
+                             calibratedSpo2(SENSOR_MAX30100, r));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, calibratedSpo2Q8(SENSOR_MAX30105, ratioQ8) / 256.0f,
+                             calibratedSpo2(SENSOR_MAX30105, r));
+  }
+}
+
+// R past the table reads as its last point, however large
+void test_ratio_beyond_table_is_clamped() {
+  TEST_ASSERT_EQUAL_INT32(15360, calibratedSpo2Q8(SENSOR_MAX30100, 512));
+  TEST_ASSERT_EQUAL_INT32(15360, calibratedSpo2Q8(SENSOR_MAX30100, 0xFFFFFFFFUL));
+  TEST_ASSERT_EQUAL_INT32(0, calibratedSpo2Q8(SENSOR_MAX30105, 0xFFFFFFFFUL));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 60.0f, calibratedSpo2(SENSOR_MAX30100, 100.0f));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 110.0f, calibratedSpo2(SENSOR_MAX30100, -1.0f));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_max30100_matches_linear_curve);
+  RUN_TEST(test_max30105_matches_maxim_curve);
+  RUN_TEST(test_reference_ratios);
+  RUN_TEST(test_float_lookup_matches_fixed_point);
+  RUN_TEST(test_ratio_beyond_table_is_clamped);
+  return UNITY_END();
+}
@@ -0,0 +1,200 @@
+// Beat (peak) detection on the AC part of the IR signal
+
+#ifndef PEAK_DETECTOR_H
+#define PEAK_DETECTOR_H
+
+#include <stdint.h>
+
+// A peak is a rising-to-falling transition of the AC signal above a fixed
+// threshold, at least minIntervalMs after the previous peak.
+// Integer-only, so the AVR and ESP8266 builds share it.
+class SlopePeakDetector {
+public:
+  SlopePeakDetector(long thresholdValue, unsigned long minIntervalMs)
+    : threshold(thresholdValue), minInterval(minIntervalMs) {
+    reset();
+  }
+
+  void reset() {
+    previous = 0;
+    rising = false;
+    lastPeakTime = 0;
+  }
+
+  // Feed one AC sample; returns true when it closes a peak
+  bool update(long ac, unsigned long timeMs) {
+    bool validTiming = (timeMs - lastPeakTime) > minInterval;
+    bool peak = false;
+
+    if (ac > previous && !rising) {
+      rising = true;
+    } else if (ac < previous && rising && validTiming && ac > threshold) {
+      rising = false;
+      lastPeakTime = timeMs;
+      peak = true;
+    }
+
+    previous = ac;
+    return peak;
+  }
+
+  bool isRising() const { return rising; }
+  unsigned long lastPeak() const { return lastPeakTime; }
+
+private:
+  long threshold;
+  unsigned long minInterval;
+  long previous;
+  bool rising;
+  unsigned long lastPeakTime;
+};
+
+// A peak is a rising-to-falling transition whose height clears a threshold
+// that follows the signal: a fraction of an envelope of recent beat heights
+// that decays between beats (so a weaker beat after a strong one is still
+// found), never below minThresholdValue. Peaks inside a refractory period, a
+// fraction of the current beat interval estimate, are ignored, which also
+// drops the dicrotic notch; a peak as tall as the envelope still counts
+// there (after minInterval), so an estimate that is too long can come down.
+// The estimate starts from the median of the first SEED_INTERVALS
+// intervals, so one missed early beat doesn't set it to twice the real
+// interval. Integer-only and O(1) per sample.
+class AdaptivePeakDetector {
+public:
+  AdaptivePeakDetector(long minThresholdValue, unsigned long minIntervalMs, unsigned long maxIntervalMs,
+                       uint8_t thresholdPercent, uint8_t refractoryPercent, uint8_t decayShift)
+    : minThreshold(minThresholdValue), minInterval(minIntervalMs), maxInterval(maxIntervalMs),
+      thresholdPct(thresholdPercent), refractoryPct(refractoryPercent), shift(decayShift) {
+    reset();
+  }
+
+  void reset() {
+    previous = 0;
+    rising = false;
+    lastPeakTime = 0;
+    envelopeQ8 = 0;
+    intervalEstimate = 0;
+    seedCount = 0;
+    lastConfidence = 0;
+    relearning = false;
+  }
+
+  // The signal level stepped (LED or ADC settings changed): forget the
+  // slope and the beat height, keep the beat timing. With no height to
+  // compare with, the next peak (often a dicrotic wave) only sets it.
+  void rebase() {
+    previous = 0;
+    rising = false;
+    envelopeQ8 = 0;
+    relearning = true;
+  }
+
+  // Feed one AC sample; returns true when it closes a peak
+  bool update(long ac, unsigned long timeMs) {
+    return update(ac, timeMs, AcceptAboveThreshold());
+  }
+
+  // As above, but every peak outside the refractory period and above half
+  // the threshold is put to confirm(aboveThreshold), which has the final
+  // say: e.g. a template match can accept a weak beat or veto an artifact
+  template <class Confirm>
+  bool update(long ac, unsigned long timeMs, const Confirm& confirm) {
+    envelopeQ8 -= envelopeQ8 >> shift;
+    bool peak = false;
+
+    if (ac > previous && !rising) {
+      rising = true;
+    } else if (ac < previous && rising) {
+      rising = false;
+      long height = previous;  // The last rising sample was the top
+      unsigned long interval = timeMs - lastPeakTime;
+      bool timely = interval > refractory() || (interval > minInterval && height >= envelope());
+      if (relearning && height > minThreshold) {
+        envelopeQ8 = height << 8;
+        relearning = false;
+      } else if (timely && height > threshold() / 2 && confirm(height > threshold())) {
+        peak = true;
+        acceptBeat(height, lastPeakTime == 0 ? 0 : interval);
+        lastPeakTime = timeMs;
+      }
+    }
+
+    previous = ac;
+    return peak;
+  }
+
+  long threshold() const {
+    long adaptive = (envelopeQ8 >> 8) * thresholdPct / 100;
+    return adaptive > minThreshold ? adaptive : minThreshold;
+  }
+  unsigned long refractory() const {
+    unsigned long adaptive = intervalEstimate * refractoryPct / 100;
+    return adaptive > minInterval ? adaptive : minInterval;
+  }
+  long envelope() const { return envelopeQ8 >> 8; }
+  unsigned long interval() const { return intervalEstimate; }  // 0 until SEED_INTERVALS intervals
+  uint8_t confidence() const { return lastConfidence; }       // 0-100, of the latest beat
+  bool isRising() const { return rising; }
+  unsigned long lastPeak() const { return lastPeakTime; }
+
+private:
+  static const uint8_t SEED_INTERVALS = 3;
+
+  struct AcceptAboveThreshold {
+    bool operator()(bool aboveThreshold) const { return aboveThreshold; }
+  };
+
+  // Confidence is the mean of how the beat's height compares with the
+  // envelope and how close its interval is to the estimate (50 when there
+  // is nothing to compare with yet). Then both estimates move towards it.
+  void acceptBeat(long height, unsigned long interval) {
+    long env = envelopeQ8 >> 8;
+    uint8_t amplitudeScore = 50;
+    if (env > 0) amplitudeScore = height >= env ? 100 : height * 100 / env;
+
+    uint8_t rhythmScore = 50;
+    if (interval > 0 && intervalEstimate > 0) {
+      unsigned long deviation = interval > intervalEstimate ? interval - intervalEstimate
+                                                            : intervalEstimate - interval;
+      rhythmScore = deviation * 2 >= intervalEstimate ? 0 : 100 - deviation * 200 / intervalEstimate;
+    }
+    lastConfidence = (amplitudeScore + rhythmScore) / 2;
+
+    // Halfway to the new height: quick to follow, but one artifact only doubles it
+    envelopeQ8 += ((height << 8) - envelopeQ8) / 2;
+
+    // Intervals over maxInterval are gaps (missed beats, finger moved)
+    if (interval == 0 || interval > maxInterval) return;
+    if (seedCount < SEED_INTERVALS) {
+      seed[seedCount++] = interval;
+      if (seedCount == SEED_INTERVALS) intervalEstimate = medianOfSeed();
+    } else {
+      intervalEstimate = (long)intervalEstimate + ((long)interval - (long)intervalEstimate) / 4;
+    }
+  }
+
+  unsigned long medianOfSeed() const {
+    unsigned long a = seed[0], b = seed[1], c = seed[2];
+    if (a > b) { unsigned long t = a; a = b; b = t; }
+    if (b > c) b = c;
+    return a > b ? a : b;
+  }
+
+  long minThreshold;
+  unsigned long minInterval;
+  unsigned long maxInterval;
+  uint8_t thresholdPct;
+  uint8_t refractoryPct;
+  uint8_t shift;
+  long previous;
+  bool rising;
+  unsigned long lastPeakTime;
+  long envelopeQ8;                // Recent beat height with 8 fractional bits
+  unsigned long intervalEstimate; // Smoothed beat interval in ms
+  unsigned long seed[SEED_INTERVALS];
+  uint8_t seedCount;
+  uint8_t lastConfidence;
+  bool relearning;                // Rebased, waiting for a peak to set the envelope
+};
+
+#endif // PEAK_DETECTOR_H
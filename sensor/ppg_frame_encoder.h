@@ -0,0 +1,206 @@
+// Binary frame encoder for the batched PPG stream
+//
+// One frame carries a run of raw samples plus the events that happened
+// meanwhile. Layout (little endian):
+//   u8  version (4)      u8  channels (2: IR, Red)
+//   u16 sequence         u32 index of the first sample
+//   u16 sample rate (Hz) u16 sample count
+// then, per sample, the IR and Red change from the previous sample (the
+// first sample is relative to 0), zigzag-mapped and varint-encoded: one or
+// two bytes for typical PPG deltas, at most three for 18-bit ADC values.
+// Then a u8 event count and the event records, each a type byte and a
+// fixed payload:
+//   EVENT_BEAT            u32 sample index, u16 beat count, u16 BPM
+//   EVENT_STATUS          u16 BPM, u8 SpO2, u16 beats, u16 median BPM x10, u8 STATUS_* flags
+//   EVENT_FINGER_REMOVED  (none)
+//   EVENT_COMPLETE        u16 final BPM x10, u8 SpO2, u16 beats
+//   EVENT_QUALITY         u8 score, u16 perfusion index x100, u8 in-band %, i8 morphology %
+//   EVENT_CONTINUOUS      u16 window BPM x10, u8 SpO2, u16 beats in window, u16 window s, u16 beats
+//
+// HEADROOM bytes are left free in front of the frame so a WebSocket
+// header can be written in place (sendBIN(..., headerToPayload = true)).
+
+#ifndef PPG_FRAME_ENCODER_H
+#define PPG_FRAME_ENCODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+template <uint8_t MAX_SAMPLES, uint8_t EVENT_BYTES, uint8_t HEADROOM = 0>
+class PpgFrameEncoder {
+public:
+  static const uint8_t VERSION = 4;
+  static const uint8_t CHANNELS = 2;
+  static const size_t HEADER_SIZE = 12;
+  static const size_t MAX_FRAME_SIZE = HEADER_SIZE + 6 * (size_t)MAX_SAMPLES + 1 + EVENT_BYTES;
+
+  static const uint8_t EVENT_BEAT = 1;
+  static const uint8_t EVENT_STATUS = 2;
+  static const uint8_t EVENT_FINGER_REMOVED = 3;
+  static const uint8_t EVENT_COMPLETE = 4;
+  static const uint8_t EVENT_QUALITY = 5;
+  static const uint8_t EVENT_CONTINUOUS = 6;
+
+  static const uint8_t STATUS_ACTIVE = 0x01;
+  static const uint8_t STATUS_COMPLETE = 0x02;
+  static const uint8_t STATUS_FINGER = 0x04;
+  static const uint8_t STATUS_BUSY = 0x08;
+
+  explicit PpgFrameEncoder(uint16_t sampleRate) : rate(sampleRate), sequence(0) {
+    clear();
+  }
+
+  // Restart the sequence numbers, e.g. for a new measurement
+  void reset() {
+    sequence = 0;
+    clear();
+  }
+
+  // Append a sample; false if the frame is full or index does not follow
+  // the previous sample (send the frame first, then add again)
+  bool addSample(unsigned long index, uint32_t ir, uint32_t red) {
+    if (count >= MAX_SAMPLES) return false;
+    if (count == 0) {
+      firstIndex = index;
+      lastIr = 0;
+      lastRed = 0;
+    } else if (index != firstIndex + count) {
+      return false;
+    }
+    putDelta((int32_t)(ir - lastIr));
+    putDelta((int32_t)(red - lastRed));
+    lastIr = ir;
+    lastRed = red;
+    count++;
+    return true;
+  }
+
+  // Event records; false when they don't fit in the frame any more
+  bool addBeat(unsigned long sampleIndex, uint16_t beatCount, uint16_t bpm) {
+    if (!beginEvent(EVENT_BEAT, 8)) return false;
+    putEvent16(sampleIndex & 0xFFFF);
+    putEvent16(sampleIndex >> 16);
+    putEvent16(beatCount);
+    putEvent16(bpm);
+    return true;
+  }
+
+  bool addStatus(uint16_t bpm, uint8_t spo2, uint16_t beatCount, uint16_t medianBpmTenths, uint8_t flags) {
+    if (!beginEvent(EVENT_STATUS, 8)) return false;
+    putEvent16(bpm);
+    events[eventBytes++] = spo2;
+    putEvent16(beatCount);
+    putEvent16(medianBpmTenths);
+    events[eventBytes++] = flags;
+    return true;
+  }
+
+  bool addFingerRemoved() {
+    return beginEvent(EVENT_FINGER_REMOVED, 0);
+  }
+
+  bool addComplete(uint16_t finalBpmTenths, uint8_t spo2, uint16_t beatCount) {
+    if (!beginEvent(EVENT_COMPLETE, 5)) return false;
+    putEvent16(finalBpmTenths);
+    events[eventBytes++] = spo2;
+    putEvent16(beatCount);
+    return true;
+  }
+
+  bool addQuality(uint8_t score, uint16_t perfusionIndex, uint8_t inBandPercent, int8_t morphologyPercent) {
+    if (!beginEvent(EVENT_QUALITY, 5)) return false;
+    events[eventBytes++] = score;
+    putEvent16(perfusionIndex);
+    events[eventBytes++] = inBandPercent;
+    events[eventBytes++] = (uint8_t)morphologyPercent;
+    return true;
+  }
+
+  bool addContinuous(uint16_t bpmTenths, uint8_t spo2, uint16_t windowBeats, uint16_t windowSeconds,
+                     uint16_t beatCount) {
+    if (!beginEvent(EVENT_CONTINUOUS, 9)) return false;
+    putEvent16(bpmTenths);
+    events[eventBytes++] = spo2;
+    putEvent16(windowBeats);
+    putEvent16(windowSeconds);
+    putEvent16(beatCount);
+    return true;
+  }
+
+  bool empty() const { return count == 0 && eventCount == 0; }
+  bool full() const { return count >= MAX_SAMPLES; }
+
+  // Finish the frame and return it, including the HEADROOM bytes
+  uint8_t* frame() {
+    uint8_t* header = buffer + HEADROOM;
+    header[0] = VERSION;
+    header[1] = CHANNELS;
+    put16(header + 2, sequence);
+    put16(header + 4, firstIndex & 0xFFFF);
+    put16(header + 6, firstIndex >> 16);
+    put16(header + 8, rate);
+    put16(header + 10, count);
+    buffer[used] = eventCount;
+    memcpy(buffer + used + 1, events, eventBytes);
+    return buffer;
+  }
+
+  // Frame length, not counting HEADROOM
+  size_t length() const { return used - HEADROOM + 1 + eventBytes; }
+
+  // Start the next frame once this one has been sent
+  void next() {
+    sequence++;
+    clear();
+  }
+
+private:
+  void clear() {
+    count = 0;
+    firstIndex = 0;
+    used = HEADROOM + HEADER_SIZE;
+    eventCount = 0;
+    eventBytes = 0;
+  }
+
+  bool beginEvent(uint8_t type, uint8_t payloadBytes) {
+    if (eventBytes + 1 + payloadBytes > EVENT_BYTES || eventCount == 0xFF) return false;
+    events[eventBytes++] = type;
+    eventCount++;
+    return true;
+  }
+
+  void putEvent16(uint16_t value) {
+    put16(events + eventBytes, value);
+    eventBytes += 2;
+  }
+
+  void putDelta(int32_t delta) {
+    uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+    while (zigzag >= 0x80) {
+      buffer[used++] = (uint8_t)(zigzag | 0x80);
+      zigzag >>= 7;
+    }
+    buffer[used++] = (uint8_t)zigzag;
+  }
+
+  static void put16(uint8_t* out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+  }
+
+  uint8_t buffer[HEADROOM + MAX_FRAME_SIZE];
+  uint8_t events[EVENT_BYTES];
+  size_t used;
+  uint16_t rate;
+  uint16_t sequence;
+  uint8_t count;
+  uint8_t eventCount;
+  uint8_t eventBytes;
+  unsigned long firstIndex;
+  uint32_t lastIr;
+  uint32_t lastRed;
+};
+
+#endif // PPG_FRAME_ENCODER_H
@@ -0,0 +1,185 @@
+// Signal quality index for the PPG
+//
+// Every WINDOW samples three checks are combined into a 0-100 score:
+//   - perfusion index: pulse amplitude as a share of the DC level, outside
+//     [minPerfusion, maxPerfusion] there is no pulse or the finger moved
+//   - in-band power: share of the AC power left after the band-pass;
+//     motion and drift put most of theirs outside the heart rate band
+//   - morphology: correlation of each beat's shape with the last beat the
+//     caller kept (SHAPE samples up to the peak); a pulse wave repeats, an
+//     artifact doesn't
+// The score is 0 when the perfusion index is out of range and otherwise
+// the lower of the in-band and morphology percentages. Callers hold each
+// beat until the window it falls in has been scored and keep it only if
+// usable(), so a beat is judged by its own stretch of signal. A window
+// straight after a failing one isn't usable either: an artifact that
+// starts late in one window runs into the next.
+
+#ifndef SIGNAL_QUALITY_H
+#define SIGNAL_QUALITY_H
+
+#include <math.h>
+#include <stdint.h>
+#include "history_ring.h"
+
+template <uint16_t WINDOW, uint8_t SHAPE>
+class SignalQuality {
+public:
+  // Perfusion limits in hundredths of a percent
+  SignalQuality(uint16_t minPerfusion, uint16_t maxPerfusion, uint8_t minScore)
+    : perfusionMin(minPerfusion), perfusionMax(maxPerfusion), scoreMin(minScore) {
+    reset();
+  }
+
+  void reset() {
+    recent.reset();
+    haveShape = false;
+    haveCandidate = false;
+    rejectedRun = 0;
+    startWindow();
+    windows = 0;
+    lastScore = 0;
+    previousScore = 0;
+    perfusion = 0;
+    inBand = 0;
+    morphology = 0;
+    lastCorrelation = 0;
+  }
+
+  // One sample: baseline, AC before and after the band-pass. True when it
+  // completes a window and the score has been updated.
+  bool update(long dc, long rawAc, long filteredAc) {
+    int16_t clipped = filteredAc > 32767 ? 32767 : (filteredAc < -32768 ? -32768 : filteredAc);
+    recent.push(clipped);
+
+    if (filteredAc > acMax) acMax = filteredAc;
+    if (filteredAc < acMin) acMin = filteredAc;
+    filteredPower += (int64_t)filteredAc * filteredAc;
+    rawPower += (int64_t)rawAc * rawAc;
+    if (++samples < WINDOW) return false;
+
+    perfusion = dc > 0 ? (uint16_t)min32((int64_t)(acMax - acMin) * 10000 / dc, 0xFFFF) : 0;
+    inBand = rawPower > 0 ? (uint8_t)min32(filteredPower * 100 / rawPower, 100) : 0;
+    if (windowBeats > 0) morphology = correlationSum / windowBeats;
+
+    bool perfused = perfusion >= perfusionMin && perfusion <= perfusionMax;
+    uint8_t shapeScore = morphology > 0 ? morphology : 0;
+    previousScore = lastScore;
+    lastScore = !perfused ? 0 : (inBand < shapeScore ? inBand : shapeScore);
+    windows++;
+    if (haveCandidate && usable()) {
+      for (uint8_t i = 0; i < SHAPE; i++) shape[i] = candidate[i];
+      haveShape = true;
+    }
+    haveCandidate = false;
+    startWindow();
+    return true;
+  }
+
+  // At a detected beat: correlation in percent (-100..100) of the last
+  // SHAPE samples with the same stretch at the last kept beat; 100 when
+  // there is nothing to compare with yet
+  int8_t beat() {
+    if (recent.size() < SHAPE) return 100;
+    int8_t r = haveShape ? correlationPercent() : 100;
+    lastCorrelation = r;
+    correlationSum += r;
+    windowBeats++;
+    return r;
+  }
+
+  // Straight after beat(): whether the caller kept the beat on its shape.
+  // A kept beat's shape is what the next beats are compared with, once its
+  // window turns out usable, so one artifact can't get the good beats after
+  // it rejected. After MAX_REJECTED_RUN rejections in a row the latest shape
+  // is taken anyway: the pulse itself changed (e.g. the finger moved) and
+  // would otherwise never be accepted again.
+  void keepBeat(bool kept) {
+    if (recent.size() < SHAPE) return;
+    if (kept) {
+      for (uint8_t i = 0; i < SHAPE; i++) candidate[i] = recent.at(recent.size() - SHAPE + i);
+      haveCandidate = true;
+      rejectedRun = 0;
+    } else if (++rejectedRun >= MAX_REJECTED_RUN) {
+      for (uint8_t i = 0; i < SHAPE; i++) shape[i] = recent.at(recent.size() - SHAPE + i);
+      haveShape = true;
+      rejectedRun = 0;
+    }
+  }
+
+  // Whether the window just scored (and the one before it) passed; true
+  // until the first window has been scored
+  bool usable() const {
+    return windows == 0 || (lastScore >= scoreMin && (windows == 1 || previousScore >= scoreMin));
+  }
+  uint8_t score() const { return lastScore; }               // 0-100, of the last window
+  uint16_t perfusionIndex() const { return perfusion; }     // Hundredths of a percent
+  uint8_t inBandPercent() const { return inBand; }
+  int8_t morphologyPercent() const { return morphology; }   // Mean beat correlation of the last window with beats
+  int8_t beatCorrelation() const { return lastCorrelation; }
+
+private:
+  static const uint8_t MAX_REJECTED_RUN = 4;
+
+  static long min32(int64_t value, long limit) { return value > limit ? limit : (long)value; }
+
+
+  void startWindow() {
+    samples = 0;
+    acMax = -2147483647L;
+    acMin = 2147483647L;
+    filteredPower = 0;
+    rawPower = 0;
+    correlationSum = 0;
+    windowBeats = 0;
+  }
+
+  // Pearson correlation in integer sums; one float divide and square root
+  int8_t correlationPercent() const {
+    int32_t sumA = 0, sumB = 0;
+    int64_t sumAB = 0, sumAA = 0, sumBB = 0;
+    for (uint8_t i = 0; i < SHAPE; i++) {
+      int32_t a = shape[i];
+      int32_t b = recent.at(recent.size() - SHAPE + i);
+      sumA += a;
+      sumB += b;
+      sumAB += (int64_t)a * b;
+      sumAA += (int64_t)a * a;
+      sumBB += (int64_t)b * b;
+    }
+    float covariance = (float)sumAB * SHAPE - (float)sumA * sumB;
+    float varianceA = (float)sumAA * SHAPE - (float)sumA * sumA;
+    float varianceB = (float)sumBB * SHAPE - (float)sumB * sumB;
+    if (varianceA <= 0 || varianceB <= 0) return 0;
+    return (int8_t)lroundf(100 * covariance / sqrtf(varianceA * varianceB));
+  }
+
+  uint16_t perfusionMin;
+  uint16_t perfusionMax;
+  uint8_t scoreMin;
+
+  HistoryRing<int16_t, SHAPE> recent;
+  int16_t shape[SHAPE];  // The last kept beat
+  bool haveShape;
+  int16_t candidate[SHAPE];  // The latest beat kept on shape, until its window is scored
+  bool haveCandidate;
+  uint8_t rejectedRun;   // Beats rejected in a row
+
+  uint16_t samples;
+  long acMax;
+  long acMin;
+  int64_t filteredPower;
+  int64_t rawPower;
+  int16_t correlationSum;
+  uint8_t windowBeats;
+
+  uint16_t windows;
+  uint8_t lastScore;
+  uint8_t previousScore;
+  uint16_t perfusion;
+  uint8_t inBand;
+  int8_t morphology;
+  int8_t lastCorrelation;
+};
+
+#endif // SIGNAL_QUALITY_H
@@ -0,0 +1,69 @@
+// Sliding-window minimum and maximum (monotonic deques)
+//
+// Each sample enters and leaves each deque at most once, so push() is O(1)
+// amortized and min()/max() are O(1), whatever the window length.
+// Values live once in a ring; the deques only hold sample numbers.
+
+#ifndef SLIDING_EXTREMA_H
+#define SLIDING_EXTREMA_H
+
+#include <stdint.h>
+
+template <uint16_t N>
+class SlidingExtrema {
+public:
+  SlidingExtrema() { reset(); }
+
+  void reset() {
+    samples = 0;
+    maxQueue.clear();
+    minQueue.clear();
+  }
+
+  void push(long value) {
+    // Expire the sample that is leaving the window before its slot is reused
+    if (samples >= N) {
+      uint32_t oldest = samples - N;
+      if (!maxQueue.empty() && maxQueue.front() == oldest) maxQueue.popFront();
+      if (!minQueue.empty() && minQueue.front() == oldest) minQueue.popFront();
+    }
+
+    values[samples % N] = value;
+    while (!maxQueue.empty() && at(maxQueue.back()) <= value) maxQueue.popBack();
+    while (!minQueue.empty() && at(minQueue.back()) >= value) minQueue.popBack();
+    maxQueue.pushBack(samples);
+    minQueue.pushBack(samples);
+    samples++;
+  }
+
+  long max() const { return maxQueue.empty() ? 0 : at(maxQueue.front()); }
+  long min() const { return minQueue.empty() ? 0 : at(minQueue.front()); }
+  bool full() const { return samples >= N; }
+
+private:
+  // Fixed-capacity deque of sample numbers
+  class IndexDeque {
+  public:
+    void clear() { head = 0; size = 0; }
+    bool empty() const { return size == 0; }
+    uint32_t front() const { return slots[head]; }
+    uint32_t back() const { return slots[(head + size - 1) % N]; }
+    void popFront() { head = (head + 1) % N; size--; }
+    void popBack() { size--; }
+    void pushBack(uint32_t index) { slots[(head + size) % N] = index; size++; }
+
+  private:
+    uint32_t slots[N];
+    uint16_t head;
+    uint16_t size;
+  };
+
+  long at(uint32_t sample) const { return values[sample % N]; }
+
+  long values[N];
+  IndexDeque maxQueue;
+  IndexDeque minQueue;
+  uint32_t samples;
+};
+
+#endif // SLIDING_EXTREMA_H
@@ -8,9 +8,82 @@ It attempts to connect to all the ESP8266 endpoints and verifies the responses.
 
 import requests
 import json
+import struct
 import time
 import argparse
 
+PPG_FRAME_HEADER = struct.Struct('<BBHIHH')
+
+# Event records after the samples: type -> (name, payload layout, field names)
+PPG_FRAME_EVENTS = {
+    1: ('beat_detected', struct.Struct('<IHH'), ('sample_index', 'beat_count', 'current_bpm')),
+    2: ('status', struct.Struct('<HBHHB'), ('heart_rate', 'spo2', 'beats_detected', 'median_bpm', 'flags')),
+    3: ('finger_removed', struct.Struct('<'), ()),
+    4: ('measurement_complete', struct.Struct('<HBH'), ('final_heart_rate', 'spo2', 'beats_detected')),
+    5: ('signal_quality', struct.Struct('<BHBb'), ('score', 'perfusion_index', 'in_band_percent', 'morphology_percent')),
+    6: ('continuous_update', struct.Struct('<HBHHH'), ('heart_rate', 'spo2', 'beats_in_window', 'window_seconds', 'beats_detected')),
+}
+PPG_STATUS_FLAGS = {'measurement_active': 0x01, 'measurement_complete': 0x02, 'finger_present': 0x04, 'server_busy': 0x08}
+
+def decode_ppg_frame(data):
+    """Decode a binary PPG stream frame (see ppg_frame_encoder.h)
+
+    Returns a dict with the header fields, a list of (index, ir, red) samples
+    and the list of events batched into the frame.
+    """
+    version, channels, sequence, first_index, sample_rate, count = PPG_FRAME_HEADER.unpack_from(data)
+    if version != 4 or channels != 2:
+        raise ValueError(f"Unsupported PPG frame version {version} with {channels} channels")
+    
+    pos = PPG_FRAME_HEADER.size
+    def next_delta():
+        nonlocal pos
+        value, shift = 0, 0
+        while True:
+            byte = data[pos]
+            pos += 1
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if byte < 0x80:
+                return (value >> 1) ^ -(value & 1)
+    
+    samples = []
+    ir = red = 0
+    for i in range(count):
+        ir += next_delta()
+        red += next_delta()
+        samples.append((first_index + i, ir, red))
+    
+    events = []
+    event_count = data[pos]
+    pos += 1
+    for _ in range(event_count):
+        name, layout, fields = PPG_FRAME_EVENTS[data[pos]]
+        event = dict(zip(fields, layout.unpack_from(data, pos + 1)))
+        pos += 1 + layout.size
+        for key in ('median_bpm', 'final_heart_rate'):
+            if key in event:
+                event[key] /= 10
+        if name == 'continuous_update':
+            event['heart_rate'] /= 10
+        if 'perfusion_index' in event:
+            event['perfusion_index'] /= 100
+        if 'flags' in event:
+            flags = event.pop('flags')
+            event.update({key: bool(flags & bit) for key, bit in PPG_STATUS_FLAGS.items()})
+        event['event'] = name
+        events.append(event)
+    if pos != len(data):
+        raise ValueError(f"PPG frame has {len(data) - pos} trailing bytes")
+    
+    return {
+        'sequence': sequence,
+        'first_index': first_index,
+        'sample_rate': sample_rate,
+        'samples': samples,
+        'events': events,
+    }
+
 def test_health(base_url):
     """Test the health endpoint"""
     print("\n1. Testing /health endpoint...")
@@ -84,10 +157,118 @@ def test_readings(base_url):
         print(f"❌ Readings test failed: {e}")
         return False
 
+def test_raw_stream(base_url, seconds):
+    """Start a measurement and decode the binary PPG stream frames from the WebSocket"""
+    print(f"\n4. Testing binary PPG stream for {seconds} seconds...")
+    try:
+        import websocket  # pip install websocket-client
+    except ImportError:
+        print("❌ Raw stream test needs the websocket-client package")
+        return False
+    
+    host = base_url.split('://', 1)[-1].split('/', 1)[0].split(':', 1)[0]
+    try:
+        ws = websocket.create_connection(f"ws://{host}:81", timeout=5)
+        ws.send(json.dumps({'command': 'stream_raw', 'enabled': True}))
+        ws.send(json.dumps({'command': 'start_measurement'}))
+        
+        frames, samples, events, payload_bytes, gaps = 0, 0, 0, 0, 0
+        next_sequence = next_index = None
+        end_time = time.time() + seconds
+        while time.time() < end_time:
+            opcode, data = ws.recv_data()
+            if opcode != websocket.ABNF.OPCODE_BINARY:
+                continue
+            frame = decode_ppg_frame(data)
+            if next_sequence is not None and frame['sequence'] != next_sequence:
+                gaps += 1
+            if next_index is not None and frame['first_index'] != next_index:
+                print(f"Samples {next_index}..{frame['first_index'] - 1} missing (sensor FIFO overflow)")
+            next_sequence = (frame['sequence'] + 1) & 0xFFFF
+            next_index = frame['first_index'] + len(frame['samples'])
+            frames += 1
+            samples += len(frame['samples'])
+            events += len(frame['events'])
+            payload_bytes += len(data)
+            for event in frame['events']:
+                if event['event'] != 'status':
+                    print(f"Event: {event}")
+        ws.close()
+    except Exception as e:
+        print(f"❌ Raw stream test failed: {e}")
+        return False
+    
+    if samples == 0:
+        print("❌ Raw stream test failed: no samples received")
+        return False
+    print(f"Received {frames} frames, {samples} samples and {events} events, {payload_bytes / samples:.1f} bytes/sample, {gaps} lost frames")
+    print("✅ Raw stream test successful!")
+    return True
+
+def test_waveform(base_url):
+    """Test the chunked waveform endpoint"""
+    print("\n5. Testing /waveform endpoint...")
+    try:
+        response = requests.get(f"{base_url}/waveform", timeout=10)
+        print(f"Status code: {response.status_code}")
+        if response.status_code == 409:
+            print("⚠️ Measurement in progress, waveform not available yet")
+            return True
+        if response.status_code != 200:
+            print(f"❌ Waveform test failed: Unexpected status code {response.status_code}")
+            return False
+        
+        data = response.json()
+        if data.get('status') == 'not_ready':
+            print("⚠️ No measurement waveform captured yet")
+            return True
+        samples = data['samples']
+        seconds = len(samples) / data['sample_rate']
+        print(f"Received {len(samples)} samples ({seconds:.1f} s) from sample {data['first_sample']}, "
+              f"{data['dropped_samples']} dropped, {len(data['beats'])} beats, {len(response.content)} bytes")
+        print("✅ Waveform test successful!")
+        return True
+    except (requests.exceptions.RequestException, KeyError, ValueError) as e:
+        print(f"❌ Waveform test failed: {e}")
+        return False
+
+def test_events(base_url, seconds):
+    """Listen to the Server-Sent Events stream"""
+    print(f"\n6. Testing /events stream for {seconds} seconds...")
+    counts = {}
+    try:
+        with requests.get(f"{base_url}/events", stream=True, timeout=(5, 20)) as response:
+            if response.status_code != 200:
+                print(f"❌ Event stream test failed: Unexpected status code {response.status_code}")
+                return False
+            end_time = time.time() + seconds
+            event = 'message'
+            for line in response.iter_lines(decode_unicode=True):
+                if line.startswith('event: '):
+                    event = line[7:]
+                elif line.startswith('data: '):
+                    data = json.loads(line[6:])
+                    counts[event] = counts.get(event, 0) + 1
+                    if event != 'sensor_data':
+                        print(f"{event}: {data}")
+                elif line == '':
+                    event = 'message'
+                if time.time() > end_time:
+                    break
+    except (requests.exceptions.RequestException, ValueError) as e:
+        print(f"❌ Event stream test failed: {e}")
+        return False
+    
+    print(f"Events received: {counts or 'none (start a measurement to see events)'}")
+    print("✅ Event stream test successful!")
+    return True
+
 def main():
     parser = argparse.ArgumentParser(description='Test ESP8266 heart rate sensor connection')
     parser.add_argument('--url', default='http://192.168.1.100', help='Base URL of the ESP8266 (default: http://192.168.1.100)')
     parser.add_argument('--skip-readings', action='store_true', help='Skip the readings test (which takes 30 seconds)')
+    parser.add_argument('--events', type=int, metavar='SECONDS', help='Also listen to the /events stream for SECONDS')
+    parser.add_argument('--raw-stream', type=int, metavar='SECONDS', help='Also decode the binary PPG stream for SECONDS')
     args = parser.parse_args()
     
     print(f"Testing connection to ESP8266 at {args.url}")
@@ -105,6 +286,19 @@ def main():
     else:
         print("\n3. Skipping /readings test as requested")
     
+    # Test the waveform of the last measurement
+    waveform_ok = test_waveform(args.url)
+    
+    # Test the binary raw sample stream (only when asked for)
+    raw_ok = True
+    if args.raw_stream:
+        raw_ok = test_raw_stream(args.url, args.raw_stream)
+    
+    # Test the Server-Sent Events stream (only when asked for)
+    events_ok = True
+    if args.events:
+        events_ok = test_events(args.url, args.events)
+    
     # Summary
     print("\n=== TEST SUMMARY ===")
     print(f"Health endpoint: {'✅ PASSED' if health_ok else '❌ FAILED'}")
@@ -113,8 +307,13 @@ def main():
         print(f"Readings endpoint: {'✅ PASSED' if readings_ok else '❌ FAILED'}")
     else:
         print("Readings endpoint: SKIPPED")
+    print(f"Waveform endpoint: {'✅ PASSED' if waveform_ok else '❌ FAILED'}")
+    if args.events:
+        print(f"Event stream: {'✅ PASSED' if events_ok else '❌ FAILED'}")
+    if args.raw_stream:
+        print(f"Binary PPG stream: {'✅ PASSED' if raw_ok else '❌ FAILED'}")
     
-    if health_ok and beat_ok and (readings_ok or args.skip_readings):
+    if health_ok and beat_ok and (readings_ok or args.skip_readings) and waveform_ok and raw_ok and events_ok:
         print("\n✅ All tests passed! Your ESP8266 is working correctly.")
     else:
         print("\n❌ Some tests failed. Please check your ESP8266 setup.")
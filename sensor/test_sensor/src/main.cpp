@@ -3,71 +3,64 @@
 
 #include <Wire.h>
 #include "MAX30105.h"
+#include "config.h"              // NanoConfig; shared with the ESP8266 build (max30100/include)
+#include "baseline_estimator.h"
+#include "peak_detector.h"
+#include "fixed_point_dsp.h"
+#include "spo2_calibration.h"
 
 MAX30105 particleSensor;
 
 // Timing variables
 unsigned long measurementStartTime = 0;
-const unsigned long MEASUREMENT_DURATION = 30000; // 30 seconds
 bool measurementActive = false;
 bool measurementComplete = false;
 
 // Beat detection variables
-const int MAX_BEATS = 120;
-unsigned long beatTimes[MAX_BEATS];
+unsigned long beatTimes[SensorConfig::maxBeats];
 int beatCount = 0;
 float calculatedBPM = 0;
 
-// Signal processing
-const int BUFFER_SIZE = 100;
-long irBuffer[BUFFER_SIZE];
-int bufferIndex = 0;
+// Signal processing (integer only - the ATmega328 has no FPU)
+MovingAverageBaseline<SensorConfig::bufferSize> irBaseline;
 long irDC = 0;    // DC component (baseline)
-long irACPrev = 0; // Previous AC value
-bool risingSlope = false;
-bool beatDetected = false;
-unsigned long lastBeatTime = 0;
-const unsigned long MIN_BEAT_INTERVAL = 250; // 250ms (240 BPM max)
+SlopePeakDetector beatDetector(SensorConfig::beatAcThreshold, SensorConfig::minBeatInterval);
+
+// Red/IR extremes since the last beat; SpO2 is evaluated once per beat from them
+long redMin, redMax, irMin, irMax;
 
 // Display variables
 int displayedBPM = 0;
 int displayedSpO2 = 0;
 
-// Debug mode (set to true to see more detailed output)
-const bool DEBUG = true;
-
 void resetMeasurement();
 void startMeasurement();
+void resetPulseExtremes();
 void finishMeasurement();
 
 void setup() {
-  Serial.begin(9600);
-  Serial.println("MAX30100 Optimized Heart Rate Monitor");
+  Serial.begin(SensorConfig::serialBaud);
+  Serial.println("MAX30105 Optimized Heart Rate Monitor");
 
   // Initialize sensor
-  if (!particleSensor.begin(Wire, I2C_SPEED_STANDARD)) { // Use standard I2C speed for MAX30100
-    Serial.println("MAX30100 was not found. Please check wiring/power.");
+  if (!particleSensor.begin(Wire, SensorConfig::i2cClockHz)) { // 400 kHz fast mode keeps bus time per sample low
+    Serial.println("MAX30105 was not found. Please check wiring/power.");
     while (1);
   }
   
   Serial.println("Sensor initialized! Place your finger on the sensor.");
 
-  // Configure sensor specifically for MAX30100
-  byte ledBrightness = 0xFF; // Full brightness for better signal
-  byte sampleAverage = 8;    // Average 8 samples for better stability
-  byte ledMode = 2;          // 2 = Red + IR
-  int sampleRate = 100;      // 100 samples per second works better for MAX30100
-  int pulseWidth = 1600;     // Maximum pulse width for more light
-  int adcRange = 16384;      // 16-bit ADC range
+  // Configure the MAX30105 (NanoConfig in config.h)
+  byte ledBrightness = SensorConfig::ledBrightness;
+  byte sampleAverage = SensorConfig::sampleAverage;
+  byte ledMode = SensorConfig::ledMode;
+  int sampleRate = SensorConfig::sampleRate;
+  int pulseWidth = SensorConfig::pulseWidth;
+  int adcRange = SensorConfig::adcRange;
   
   particleSensor.setup(ledBrightness, sampleAverage, ledMode, sampleRate, pulseWidth, adcRange);
   particleSensor.setPulseAmplitudeRed(0xFF); // Maximum LED power
   particleSensor.setPulseAmplitudeIR(0xFF);  // Maximum LED power
-  
-  // Initialize buffer
-  for (int i = 0; i < BUFFER_SIZE; i++) {
-    irBuffer[i] = 0;
-  }
 }
 
 void loop() {
@@ -76,7 +69,7 @@ void loop() {
   long redValue = particleSensor.getRed();
 
   // Check if finger is placed on sensor
-  if (irValue < 30000) { // Lower threshold for detection
+  if (irValue < SensorConfig::fingerPresenceThreshold) {
     resetMeasurement();
     Serial.println("No finger detected. Place finger on sensor.");
     delay(1000);
@@ -86,44 +79,37 @@ void loop() {
   // Start measurement when finger is detected
   if (!measurementActive && !measurementComplete) {
     startMeasurement();
-    // Initialize buffer with current value
-    for (int i = 0; i < BUFFER_SIZE; i++) {
-      irBuffer[i] = irValue;
-    }
-    irDC = irValue;
   }
   
   // Process signal and detect beats during measurement
   if (measurementActive) {
-    // Update buffer
-    irBuffer[bufferIndex] = irValue;
-    bufferIndex = (bufferIndex + 1) % BUFFER_SIZE;
-    
-    // Calculate DC component (baseline) - moving average
-    irDC = 0;
-    for (int i = 0; i < BUFFER_SIZE; i++) {
-      irDC += irBuffer[i];
-    }
-    irDC /= BUFFER_SIZE;
+    // Calculate DC component (baseline) - running-sum moving average
+    irDC = irBaseline.update(irValue);
     
     // Extract AC component (pulsatile)
     long irAC = irValue - irDC;
     
-    // Beat detection using slope detection
-    unsigned long currentTime = millis();
-    boolean validBeatTiming = (currentTime - lastBeatTime) > MIN_BEAT_INTERVAL;
-    
-    // Rising slope detection
-    if (irAC > irACPrev && !risingSlope) {
-      risingSlope = true;
+    // Track this beat's extremes for SpO2
+    if (redValue > SensorConfig::fingerPresenceThreshold) {
+      if (redValue < redMin) redMin = redValue;
+      if (redValue > redMax) redMax = redValue;
+      if (irValue < irMin) irMin = irValue;
+      if (irValue > irMax) irMax = irValue;
     }
-    // Peak detection (transition from rising to falling)
-    else if (irAC < irACPrev && risingSlope && validBeatTiming && irAC > 50) {
-      risingSlope = false;
-      lastBeatTime = currentTime;
+    
+    // Beat detection using slope detection (rising-to-falling transition)
+    unsigned long currentTime = millis();
+    if (beatDetector.update(irAC, currentTime)) {
+      // SpO2 from the ratio of ratios over the beat that just ended (Q8 fixed point);
+      // before the second beat the extremes don't span a whole pulse
+      if (beatCount >= 1 && irMax > irMin && redMin > 0) {
+        uint32_t ratioQ8 = ratioOfRatiosQ8(redMax - redMin, redMin, irMax - irMin, irMin);
+        displayedSpO2 = roundQ8(clampSpo2Q8(calibratedSpo2Q8(SensorConfig::sensorModel, ratioQ8)));
+      }
+      resetPulseExtremes();
       
       // Record beat
-      if (beatCount < MAX_BEATS) {
+      if (beatCount < SensorConfig::maxBeats) {
         beatTimes[beatCount] = currentTime;
         beatCount++;
         
@@ -136,7 +122,7 @@ void loop() {
           displayedBPM = 60000 / delta;
           
           // Sanity check
-          if (displayedBPM < 40 || displayedBPM > 220) {
+          if (displayedBPM < SensorConfig::minValidBpm || displayedBPM > SensorConfig::maxValidBpm) {
             displayedBPM = 0; // Invalid reading
           } else {
             Serial.print("Current BPM: ");
@@ -146,11 +132,8 @@ void loop() {
       }
     }
     
-    // Store current AC value for next comparison
-    irACPrev = irAC;
-    
     // Debug output
-    if (DEBUG && currentTime % 500 < 10) {
+    if (SensorConfig::debug && currentTime % 500 < 10) {
       Serial.print("IR: ");
       Serial.print(irValue);
       Serial.print(", DC: ");
@@ -158,28 +141,18 @@ void loop() {
       Serial.print(", AC: ");
       Serial.print(irAC);
       Serial.print(", Rising: ");
-      Serial.println(risingSlope ? "Yes" : "No");
+      Serial.println(beatDetector.isRising() ? "Yes" : "No");
     }
     
     // Check if measurement duration has elapsed
-    if (currentTime - measurementStartTime >= MEASUREMENT_DURATION) {
+    if (currentTime - measurementStartTime >= SensorConfig::measurementDuration) {
       finishMeasurement();
     }
     
-    // Calculate SpO2 (simplified approximation)
-    if (irValue > 30000 && redValue > 30000) {
-      float ratio = (float)redValue / (float)irValue;
-      displayedSpO2 = 110 - 25 * ratio;
-      
-      // Clamp to reasonable range
-      if (displayedSpO2 > 100) displayedSpO2 = 100;
-      if (displayedSpO2 < 80) displayedSpO2 = 80;
-    }
-    
     // Show progress during measurement every 3 seconds
     if (millis() % 3000 < 10) {
       unsigned long elapsedTime = currentTime - measurementStartTime;
-      int progressPercent = (elapsedTime * 100) / MEASUREMENT_DURATION;
+      int progressPercent = (elapsedTime * 100) / SensorConfig::measurementDuration;
       
       Serial.print("Progress: ");
       Serial.print(progressPercent);
@@ -223,8 +196,9 @@ void startMeasurement() {
   // Reset variables
   beatCount = 0;
   calculatedBPM = 0;
-  irACPrev = 0;
-  risingSlope = false;
+  irBaseline.reset();
+  beatDetector.reset();
+  resetPulseExtremes();
   
   // Set timing
   measurementStartTime = millis();
@@ -241,14 +215,18 @@ void finishMeasurement() {
     // Calculate time elapsed between first and last beat
     unsigned long totalMeasurementTime = beatTimes[beatCount - 1] - beatTimes[0];
     
-    // Calculate BPM: (beats-1) / minutes
-    float minutesElapsed = totalMeasurementTime / 60000.0;
-    calculatedBPM = (beatCount - 1) / minutesElapsed;
+    // Calculate BPM: (beats-1) / minutes, in integer tenths of a BPM
+    calculatedBPM = bpmTenths(beatCount - 1, totalMeasurementTime) / 10.0;
   } else {
     calculatedBPM = 0; // Not enough beats detected
   }
 }
 
+void resetPulseExtremes() {
+  redMin = irMin = 0x7FFFFFFFL;
+  redMax = irMax = 0;
+}
+
 void resetMeasurement() {
   measurementActive = false;
   measurementComplete = false;
@@ -0,0 +1,60 @@
+// Fixed-rate cooperative tick for the sampling/DSP work
+//
+// The caller passes micros() in, so the logic runs unchanged on the host.
+// All comparisons use wrap-safe signed differences (micros() wraps every ~71 min).
+
+#ifndef TICK_SCHEDULER_H
+#define TICK_SCHEDULER_H
+
+#include <stdint.h>
+
+class TickScheduler {
+public:
+  explicit TickScheduler(unsigned long periodUs)
+    : period(periodUs), deadline(0), missed(0), ticks(0), maxLateness(0) {}
+
+  void begin(unsigned long nowUs) {
+    deadline = nowUs + period;
+    missed = 0;
+    ticks = 0;
+    maxLateness = 0;
+  }
+
+  // True when the current deadline has passed; advances to the next one.
+  // A tick that starts a full period or more late counts as missed and the
+  // schedule is re-anchored to now instead of firing a burst of catch-up ticks.
+  bool due(unsigned long nowUs) {
+    long late = (long)(nowUs - deadline);
+    if (late < 0) return false;
+
+    if ((unsigned long)late > maxLateness) maxLateness = late;
+    if ((unsigned long)late >= period) {
+      missed += late / period;
+      deadline = nowUs + period;
+    } else {
+      deadline += period;
+    }
+    ticks++;
+    return true;
+  }
+
+  // Time left before the next deadline, 0 if it has already passed
+  unsigned long remainingUs(unsigned long nowUs) const {
+    long left = (long)(deadline - nowUs);
+    return left > 0 ? (unsigned long)left : 0;
+  }
+
+  unsigned long periodUs() const { return period; }
+  unsigned long missedDeadlines() const { return missed; }
+  unsigned long tickCount() const { return ticks; }
+  unsigned long maxLatenessUs() const { return maxLateness; }
+
+private:
+  unsigned long period;
+  unsigned long deadline;
+  unsigned long missed;
+  unsigned long ticks;
+  unsigned long maxLateness;
+};
+
+#endif // TICK_SCHEDULER_H